@@ -1,2 +0,0 @@
-glslc ./src/shaders/shader.vert -o ./src/shaders/compiled/vert.spv
-glslc ./src/shaders/shader.frag -o ./src/shaders/compiled/frag.spv
\ No newline at end of file
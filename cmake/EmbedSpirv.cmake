@@ -0,0 +1,30 @@
+# Turns a SPIR-V binary into a header holding its words as a constexpr uint32_t array
+#   cmake -DINPUT=<shader.vert.spv> -DOUTPUT=<shader.vert.h> -P EmbedSpirv.cmake
+# The array is named after the shader source, shader.vert becomes SPIRV_SHADER_VERT
+
+file(READ "${INPUT}" hex HEX)
+string(LENGTH "${hex}" hex_length)
+math(EXPR word_remainder "${hex_length} % 8")
+if (hex_length EQUAL 0 OR NOT word_remainder EQUAL 0)
+  message(FATAL_ERROR "${INPUT} is not a SPIR-V binary")
+endif()
+
+# glslc writes little endian words, eight of them per line
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " words "${hex}")
+set(word "0x[0-9a-f]+, ")
+string(REGEX REPLACE "(${word}${word}${word}${word}${word}${word}${word}${word})" "\\1\n    " words "${words}")
+string(REGEX REPLACE "[ \n]+$" "" words "${words}")
+string(REPLACE ", \n" ",\n" words "${words}")
+
+get_filename_component(shader_name "${OUTPUT}" NAME)
+string(REGEX REPLACE "\\.h$" "" shader_name "${shader_name}")
+string(MAKE_C_IDENTIFIER "SPIRV_${shader_name}" identifier)
+string(TOUPPER "${identifier}" identifier)
+
+file(WRITE "${OUTPUT}"
+  "// Generated from ${shader_name} by cmake/EmbedSpirv.cmake, do not edit\n"
+  "#pragma once\n\n"
+  "#include <cstdint>\n\n"
+  "constexpr uint32_t ${identifier}[] = {\n"
+  "    ${words}\n"
+  "};\n")
@@ -0,0 +1,126 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+Benchmark::Benchmark(uint64_t warmupFrames)
+    :warmupFrames(warmupFrames)
+{}
+
+void Benchmark::beginFrame(uint64_t frame)
+{
+    if (!started && frame >= warmupFrames) {
+        started = true;
+        startTime = std::chrono::steady_clock::now();
+    }
+}
+
+void Benchmark::addCpuFrame(uint64_t frame, double milliseconds)
+{
+    if (frame < warmupFrames) {
+        return;
+    }
+    cpuFrames.push_back(milliseconds);
+    endTime = std::chrono::steady_clock::now();
+}
+
+void Benchmark::addGpuFrame(uint64_t frame, double milliseconds)
+{
+    if (frame >= warmupFrames) {
+        gpuFrames.push_back(milliseconds);
+    }
+}
+
+void Benchmark::addGpuPass(uint64_t frame, const std::string& name, double milliseconds)
+{
+    if (frame >= warmupFrames) {
+        addSample(passes, name, milliseconds);
+    }
+}
+
+void Benchmark::addCounter(uint64_t frame, const std::string& name, double value)
+{
+    if (frame >= warmupFrames) {
+        addSample(counterSeries, name, value);
+    }
+}
+
+void Benchmark::addSample(std::vector<std::pair<std::string, std::vector<double>>>& series, const std::string& name, double value)
+{
+    for (auto& entry : series) {
+        if (entry.first == name) {
+            entry.second.push_back(value);
+            return;
+        }
+    }
+    series.emplace_back(name, std::vector<double>{value});
+}
+
+double Benchmark::seconds() const
+{
+    if (cpuFrames.empty()) {
+        return 0.0;
+    }
+    return std::chrono::duration<double>(endTime - startTime).count();
+}
+
+TimingSummary Benchmark::summarize(std::vector<double> samples)
+{
+    TimingSummary summary{};
+    summary.count = samples.size();
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&](double p) {
+        size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+        return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+    };
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    summary.mean    = sum / samples.size();
+    summary.min     = samples.front();
+    summary.p50     = percentile(50.0);
+    summary.p95     = percentile(95.0);
+    summary.p99     = percentile(99.0);
+    summary.max     = samples.back();
+    return summary;
+}
+
+void Benchmark::writeJson(std::ostream& out, const TimingSummary& summary, const std::string& indent)
+{
+    std::string field = "\n" + indent + "    ";
+    out << "{"
+        << field << "\"count\": " << summary.count << ","
+        << field << "\"mean\": " << summary.mean << ","
+        << field << "\"min\": " << summary.min << ","
+        << field << "\"p50\": " << summary.p50 << ","
+        << field << "\"p95\": " << summary.p95 << ","
+        << field << "\"p99\": " << summary.p99 << ","
+        << field << "\"max\": " << summary.max
+        << "\n" << indent << "}";
+}
+
+std::string Benchmark::jsonString(const std::string& value)
+{
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+        }
+        else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+// Distribution of one series, milliseconds for timings, percentiles use the nearest rank
+struct TimingSummary {
+    size_t  count;
+    double  mean;
+    double  min;
+    double  p50;
+    double  p95;
+    double  p99;
+    double  max;
+};
+
+// Frame timings of a --benchmark run
+// Frames are numbered in submission order, the first warmupFrames of them are dropped so pipeline compiles,
+// first uploads and driver warm-up don't skew the results. GPU times arrive a few frames late, tagged with the
+// frame they belong to.
+class Benchmark
+{
+public:
+    explicit Benchmark(uint64_t warmupFrames = 0);
+
+    // Call at the start of every frame, the wall clock interval starts with the first measured one
+    void beginFrame(uint64_t frame);
+    void addCpuFrame(uint64_t frame, double milliseconds);
+    void addGpuFrame(uint64_t frame, double milliseconds);
+    void addGpuPass(uint64_t frame, const std::string& name, double milliseconds);
+    // Per frame count of a GPU counter, summarized like the timings
+    void addCounter(uint64_t frame, const std::string& name, double value);
+
+    uint64_t        measuredFrames() const { return cpuFrames.size(); }
+    double          seconds() const;
+    TimingSummary   cpuSummary() const { return summarize(cpuFrames); }
+    TimingSummary   gpuSummary() const { return summarize(gpuFrames); }
+    bool            hasGpuFrames() const { return !gpuFrames.empty(); }
+    // Passes in the order they were first seen
+    const std::vector<std::pair<std::string, std::vector<double>>>& gpuPasses() const { return passes; }
+    const std::vector<std::pair<std::string, std::vector<double>>>& counters() const { return counterSeries; }
+
+    static TimingSummary summarize(std::vector<double> samples);
+    // One field per line, indent is that of the line the object starts on
+    static void writeJson(std::ostream& out, const TimingSummary& summary, const std::string& indent);
+    static std::string jsonString(const std::string& value);
+
+private:
+    static void addSample(std::vector<std::pair<std::string, std::vector<double>>>& series, const std::string& name, double value);
+
+    uint64_t                                warmupFrames;
+    std::vector<double>                     cpuFrames;
+    std::vector<double>                     gpuFrames;
+    std::vector<std::pair<std::string, std::vector<double>>> passes;
+    std::vector<std::pair<std::string, std::vector<double>>> counterSeries;
+    bool                                    started         = false;
+    std::chrono::steady_clock::time_point   startTime;
+    std::chrono::steady_clock::time_point   endTime;
+};
@@ -0,0 +1,145 @@
+#include "CpuProfiler.h"
+#include "Benchmark.h"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Fields are relaxed atomics so the dump may read a slot while its thread overwrites it. sequence is a seqlock:
+// 2 * index + 1 while event index is being written, 2 * index + 2 once it is complete.
+struct TraceEvent {
+    std::atomic<uint64_t>       sequence{0};
+    std::atomic<const char*>    name{nullptr};
+    std::atomic<uint64_t>       start{0};
+    std::atomic<uint64_t>       end{0};
+};
+
+struct StartupEvent {
+    const char* name;
+    uint64_t    start;
+    uint64_t    end;
+};
+
+struct ThreadTrace {
+    uint32_t                    id;
+    std::string                 name;       // Guarded by threadTracesMutex
+    std::vector<StartupEvent>   startupEvents;  // Guarded by threadTracesMutex, never overwritten
+    std::atomic<uint64_t>       written{0}; // Events ever recorded, the next one goes to written % CPU_PROFILER_RING_EVENTS
+    TraceEvent                  events[CPU_PROFILER_RING_EVENTS];
+};
+
+std::atomic<bool> CpuProfiler::enabledFlag{false};
+std::atomic<bool> CpuProfiler::startupFlag{true};
+
+static const std::chrono::steady_clock::time_point profilerEpoch = std::chrono::steady_clock::now();
+static std::mutex threadTracesMutex;
+// Never shrinks, a thread's events stay in the trace after it exits
+static std::vector<std::unique_ptr<ThreadTrace>> threadTraces;
+static thread_local ThreadTrace* currentThreadTrace = nullptr;
+
+static ThreadTrace* threadTrace()
+{
+    if (currentThreadTrace == nullptr) {
+        std::unique_ptr<ThreadTrace> trace = std::make_unique<ThreadTrace>();
+        std::lock_guard<std::mutex> lock(threadTracesMutex);
+        trace->id = static_cast<uint32_t>(threadTraces.size() + 1);
+        trace->name = "thread " + std::to_string(trace->id);
+        currentThreadTrace = trace.get();
+        threadTraces.push_back(std::move(trace));
+    }
+    return currentThreadTrace;
+}
+
+void CpuProfiler::setEnabled(bool enabled)
+{
+    enabledFlag.store(enabled, std::memory_order_relaxed);
+}
+
+void CpuProfiler::setThreadName(const std::string& name)
+{
+    if (!enabled()) {
+        return;
+    }
+    ThreadTrace* trace = threadTrace();
+    std::lock_guard<std::mutex> lock(threadTracesMutex);
+    trace->name = name;
+}
+
+void CpuProfiler::endStartup()
+{
+    startupFlag.store(false, std::memory_order_relaxed);
+}
+
+uint64_t CpuProfiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profilerEpoch).count();
+}
+
+void CpuProfiler::record(const char* name, uint64_t start, uint64_t end)
+{
+    ThreadTrace* trace = threadTrace();
+    // Startup records few events, taking the lock for them is fine
+    if (startupFlag.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(threadTracesMutex);
+        trace->startupEvents.push_back({name, start, end});
+        return;
+    }
+    uint64_t index = trace->written.load(std::memory_order_relaxed);
+    TraceEvent& event = trace->events[index % CPU_PROFILER_RING_EVENTS];
+    // The fence keeps the field stores from becoming visible before the odd sequence
+    event.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    event.sequence.store(2 * index + 2, std::memory_order_release);
+    trace->written.store(index + 1, std::memory_order_release);
+}
+
+bool CpuProfiler::writeChromeTrace(const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+    file.setf(std::ios::fixed);
+    file.precision(3);
+
+    std::lock_guard<std::mutex> lock(threadTracesMutex);
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+    bool first = true;
+    for (const std::unique_ptr<ThreadTrace>& trace : threadTraces) {
+        file << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << trace->id
+             << ", \"args\": {\"name\": " << Benchmark::jsonString(trace->name) << "}}";
+        first = false;
+
+        for (const StartupEvent& event : trace->startupEvents) {
+            file << ",\n{\"name\": " << Benchmark::jsonString(event.name) << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << trace->id
+                 << ", \"ts\": " << event.start / 1000.0 << ", \"dur\": " << (event.end - event.start) / 1000.0 << "}";
+        }
+
+        // A slot is kept only if its sequence says event i was complete both before and after reading the fields,
+        // anything the thread overwrote or was still writing meanwhile is dropped
+        uint64_t written = trace->written.load(std::memory_order_acquire);
+        uint64_t begin = written > CPU_PROFILER_RING_EVENTS ? written - CPU_PROFILER_RING_EVENTS : 0;
+        for (uint64_t i = begin; i < written; i++) {
+            const TraceEvent& event = trace->events[i % CPU_PROFILER_RING_EVENTS];
+            uint64_t before = event.sequence.load(std::memory_order_acquire);
+            const char* name = event.name.load(std::memory_order_relaxed);
+            uint64_t start = event.start.load(std::memory_order_relaxed);
+            uint64_t end = event.end.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t after = event.sequence.load(std::memory_order_relaxed);
+            if (before != 2 * i + 2 || after != before) {
+                continue;
+            }
+            // Names are arbitrary strings, pipeline names among them
+            file << ",\n{\"name\": " << Benchmark::jsonString(name) << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << trace->id
+                 << ", \"ts\": " << start / 1000.0 << ", \"dur\": " << (end - start) / 1000.0 << "}";
+        }
+    }
+    file << std::endl << "]}" << std::endl;
+    return static_cast<bool>(file);
+}
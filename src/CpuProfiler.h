@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+// Events kept per thread, older ones are overwritten
+const uint32_t CPU_PROFILER_RING_EVENTS = 1 << 16;
+
+// Scoped CPU timing markers exported as a Chrome trace (chrome://tracing, ui.perfetto.dev)
+// Each thread writes its events into its own ring buffer, after startup only registering a thread's buffer takes a
+// lock. The dump reads the rings while they are being written and drops events that were overwritten during the copy.
+// Event names are not copied, they have to stay valid until the last dump, string literals in practice.
+// Events recorded before endStartup go into an unbounded list instead of the rings, so the startup steps stay in the
+// trace however long the run is. While disabled a marker costs one relaxed atomic load.
+class CpuProfiler
+{
+public:
+    static void setEnabled(bool enabled);
+    static bool enabled() { return enabledFlag.load(std::memory_order_relaxed); }
+    // Shown as the thread's name in the trace, for the calling thread
+    static void setThreadName(const std::string& name);
+    // Every later event goes to the rings, call once when startup is done
+    static void endStartup();
+
+    // Nanoseconds since the process started profiling
+    static uint64_t now();
+    static void record(const char* name, uint64_t start, uint64_t end);
+    // Writes every event still in the rings as Chrome trace JSON, callable from any thread at any time
+    static bool writeChromeTrace(const std::string& path);
+
+private:
+    static std::atomic<bool> enabledFlag;
+    static std::atomic<bool> startupFlag;
+};
+
+// Records the lifetime of the scope as one event
+class CpuProfileScope
+{
+public:
+    explicit CpuProfileScope(const char* name)
+        :name(name), active(CpuProfiler::enabled()), start(active ? CpuProfiler::now() : 0)
+    {}
+    ~CpuProfileScope()
+    {
+        if (active) {
+            CpuProfiler::record(name, start, CpuProfiler::now());
+        }
+    }
+    CpuProfileScope(const CpuProfileScope&) = delete;
+    CpuProfileScope& operator=(const CpuProfileScope&) = delete;
+
+private:
+    const char* name;
+    bool        active;
+    uint64_t    start;
+};
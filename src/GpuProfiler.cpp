@@ -0,0 +1,118 @@
+#include "GpuProfiler.h"
+
+#include <iostream>
+#include <stdexcept>
+
+#include <vulkan/vk_enum_string_helper.h>
+
+void GpuProfiler::init(VkDevice device, uint32_t frameCount, float timestampPeriod, uint32_t timestampValidBits)
+{
+    this->device = device;
+    this->timestampPeriod = timestampPeriod;
+    timestampMask = timestampValidBits >= 64 ? UINT64_MAX : (uint64_t(1) << timestampValidBits) - 1;
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType         = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType     = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount    = 2 * GPU_PROFILER_MAX_REGIONS;
+
+    queryPools.resize(frameCount);
+    for (VkQueryPool& pool : queryPools) {
+        VkResult result = vkCreateQueryPool(device, &queryPoolInfo, nullptr, &pool);
+        if (result != VK_SUCCESS) {
+            std::cerr << string_VkResult(result) << std::endl;
+            throw std::runtime_error("[VULKAN] Failed to create timestamp QueryPool");
+        }
+    }
+}
+
+void GpuProfiler::destroy()
+{
+    for (VkQueryPool pool : queryPools) {
+        vkDestroyQueryPool(device, pool, nullptr);
+    }
+    queryPools.clear();
+}
+
+uint32_t GpuProfiler::region(const std::string& name)
+{
+    for (uint32_t i = 0; i < regions.size(); i++) {
+        if (regions[i].name == name) {
+            return i;
+        }
+    }
+    if (regions.size() == GPU_PROFILER_MAX_REGIONS) {
+        throw std::runtime_error("[GPU] Too many profiler regions");
+    }
+    regions.emplace_back();
+    regions.back().name = name;
+    return static_cast<uint32_t>(regions.size() - 1);
+}
+
+// The whole pool is reset, regions registered after this command buffer was recorded stay unavailable instead of
+// holding results of an older frame
+void GpuProfiler::resetFrame(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+    vkCmdResetQueryPool(commandBuffer, queryPools[frame], 0, 2 * GPU_PROFILER_MAX_REGIONS);
+}
+
+void GpuProfiler::begin(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t region)
+{
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPools[frame], 2 * region);
+}
+
+void GpuProfiler::end(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t region)
+{
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPools[frame], 2 * region + 1);
+}
+
+bool GpuProfiler::collect(uint32_t frame)
+{
+    if (regions.empty()) {
+        return false;
+    }
+
+    // Each query comes back as its value followed by its availability, VK_NOT_READY only means some are missing
+    std::vector<uint64_t> results(4 * regions.size());
+    VkResult result = vkGetQueryPoolResults(device, queryPools[frame], 0, 2 * regionCount(), results.size() * sizeof(uint64_t),
+                                            results.data(), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to read timestamp queries");
+    }
+
+    bool collected = false;
+    for (uint32_t i = 0; i < regions.size(); i++) {
+        Region& region = regions[i];
+        const uint64_t* query = &results[4 * i];
+        if (query[1] == 0 || query[3] == 0) {
+            region.lastMs = -1.0;
+            continue;
+        }
+        region.lastMs = ((query[2] - query[0]) & timestampMask) * timestampPeriod / 1e6;
+        if (region.historyCount == GPU_PROFILER_ROLLING_FRAMES) {
+            region.historySum -= region.history[region.historyNext];
+        }
+        else {
+            region.historyCount++;
+        }
+        region.history[region.historyNext] = region.lastMs;
+        region.historySum += region.lastMs;
+        region.historyNext = (region.historyNext + 1) % GPU_PROFILER_ROLLING_FRAMES;
+        collected = true;
+    }
+    return collected;
+}
+
+std::vector<GpuRegionStats> GpuProfiler::stats() const
+{
+    std::vector<GpuRegionStats> regionStats;
+    for (const Region& region : regions) {
+        GpuRegionStats stats{};
+        stats.name      = region.name;
+        stats.lastMs    = region.lastMs;
+        stats.averageMs = region.historyCount > 0 ? region.historySum / region.historyCount : 0.0;
+        regionStats.push_back(stats);
+    }
+    return regionStats;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+const uint32_t GPU_PROFILER_MAX_REGIONS     = 32;
+const uint32_t GPU_PROFILER_ROLLING_FRAMES  = 64;
+
+struct GpuRegionStats {
+    std::string name;
+    double      lastMs;         // Of the newest collected frame, negative if that frame didn't contain the region
+    double      averageMs;      // Over the last GPU_PROFILER_ROLLING_FRAMES frames that contained the region
+};
+
+// Timestamp query profiler
+// Regions are registered by name once and bracketed with begin and end while recording. Every frame in flight has
+// its own query pool, reset by resetFrame at the start of the frame's command buffer, so cached command buffers
+// replay as they are. collect reads a frame's pool after its fence has signalled and never waits, regions the frame
+// didn't write are skipped.
+class GpuProfiler
+{
+public:
+    GpuProfiler() = default;
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // timestampValidBits of the queue the command buffers run on, must not be 0
+    void init(VkDevice device, uint32_t frameCount, float timestampPeriod, uint32_t timestampValidBits);
+    void destroy();
+    bool enabled() const { return !queryPools.empty(); }
+
+    // Returns the index of the region with this name, registering it on first use
+    uint32_t region(const std::string& name);
+    // Outside of render passes and before any region of the frame
+    void resetFrame(VkCommandBuffer commandBuffer, uint32_t frame);
+    void begin(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t region);
+    void end(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t region);
+
+    // Only for frames that were submitted since their last collect, returns false if nothing could be read
+    bool collect(uint32_t frame);
+    uint32_t            regionCount() const { return static_cast<uint32_t>(regions.size()); }
+    const std::string&  regionName(uint32_t region) const { return regions[region].name; }
+    double              lastMs(uint32_t region) const { return regions[region].lastMs; }
+    std::vector<GpuRegionStats> stats() const;
+
+private:
+    struct Region {
+        std::string name;
+        double      lastMs                                  = -1.0;
+        double      history[GPU_PROFILER_ROLLING_FRAMES]    = {};
+        double      historySum                              = 0.0;
+        uint32_t    historyCount                            = 0;
+        uint32_t    historyNext                             = 0;
+    };
+
+    VkDevice                    device                  = VK_NULL_HANDLE;
+    float                       timestampPeriod         = 1.0f;
+    uint64_t                    timestampMask           = 0;
+    std::vector<VkQueryPool>    queryPools;
+    std::vector<Region>         regions;
+};
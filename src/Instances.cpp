@@ -0,0 +1,124 @@
+#include "Instances.h"
+
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+InstanceSet::InstanceSet(uint32_t frameCount)
+    :dirtyPages(frameCount)
+{}
+
+void InstanceSet::markDirty(uint32_t slot)
+{
+    boundsStale = true;
+    uint32_t page = slot / PAGE_INSTANCES;
+    for (std::vector<uint64_t>& pages : dirtyPages) {
+        if (pages.size() <= page / 64) {
+            pages.resize(page / 64 + 1, 0);
+        }
+        pages[page / 64] |= uint64_t(1) << (page % 64);
+    }
+}
+
+InstanceHandle InstanceSet::add(const InstanceData& instance)
+{
+    InstanceHandle handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    }
+    else {
+        handle = static_cast<InstanceHandle>(slotOfHandle.size());
+        slotOfHandle.push_back(0);
+    }
+
+    uint32_t slot = count();
+    slotOfHandle[handle] = slot;
+    handleOfSlot.push_back(handle);
+    instances.push_back(instance);
+    markDirty(slot);
+    return handle;
+}
+
+void InstanceSet::remove(InstanceHandle handle)
+{
+    uint32_t slot = slotOfHandle[handle];
+    uint32_t last = count() - 1;
+    if (slot != last) {
+        instances[slot] = instances[last];
+        handleOfSlot[slot] = handleOfSlot[last];
+        slotOfHandle[handleOfSlot[slot]] = slot;
+        markDirty(slot);
+    }
+    instances.pop_back();
+    handleOfSlot.pop_back();
+    boundsStale = true;
+    freeHandles.push_back(handle);
+}
+
+void InstanceSet::update(InstanceHandle handle, const InstanceData& instance)
+{
+    uint32_t slot = slotOfHandle[handle];
+    instances[slot] = instance;
+    markDirty(slot);
+}
+
+const InstanceBounds& InstanceSet::bounds() const
+{
+    if (!boundsStale) {
+        return cachedBounds;
+    }
+    cachedBounds = InstanceBounds{};
+    if (!instances.empty()) {
+        cachedBounds.min = glm::vec3(std::numeric_limits<float>::max());
+        cachedBounds.max = glm::vec3(std::numeric_limits<float>::lowest());
+    }
+    for (const InstanceData& instance : instances) {
+        glm::vec3 translation = glm::vec3(instance.model[3]);
+        cachedBounds.min = glm::min(cachedBounds.min, translation);
+        cachedBounds.max = glm::max(cachedBounds.max, translation);
+        float squaredNorm = 0.0f;
+        for (int column = 0; column < 3; column++) {
+            glm::vec3 deviation = glm::vec3(instance.model[column]);
+            deviation[column] -= 1.0f;
+            squaredNorm += glm::dot(deviation, deviation);
+        }
+        cachedBounds.maxLinearDeviation = std::max(cachedBounds.maxLinearDeviation, std::sqrt(squaredNorm));
+    }
+    boundsStale = false;
+    return cachedBounds;
+}
+
+void InstanceSet::invalidate(uint32_t frame)
+{
+    uint32_t pageCount = (count() + PAGE_INSTANCES - 1) / PAGE_INSTANCES;
+    dirtyPages[frame].assign((pageCount + 63) / 64, ~uint64_t(0));
+}
+
+size_t InstanceSet::writeDirty(uint32_t frame, void* dst)
+{
+    std::vector<uint64_t>& pages = dirtyPages[frame];
+    uint32_t pageCount = (count() + PAGE_INSTANCES - 1) / PAGE_INSTANCES;
+    size_t written = 0;
+
+    uint32_t page = 0;
+    while (page < pageCount) {
+        if (page / 64 >= pages.size() || !(pages[page / 64] & (uint64_t(1) << (page % 64)))) {
+            page++;
+            continue;
+        }
+        uint32_t firstPage = page;
+        while (page < pageCount && page / 64 < pages.size() && (pages[page / 64] & (uint64_t(1) << (page % 64)))) {
+            page++;
+        }
+        uint32_t first = firstPage * PAGE_INSTANCES;
+        uint32_t end = std::min(page * PAGE_INSTANCES, count());
+        size_t bytes = size_t(end - first) * sizeof(InstanceData);
+        memcpy(static_cast<char*>(dst) + size_t(first) * sizeof(InstanceData), &instances[first], bytes);
+        written += bytes;
+    }
+    // Pages past the end only hold removed instances, nothing draws them
+    pages.assign(pages.size(), 0);
+    return written;
+}
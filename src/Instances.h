@@ -0,0 +1,94 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Per-instance vertex attributes, bound at binding 1 with VK_VERTEX_INPUT_RATE_INSTANCE. The model matrix is applied
+// on top of the shared mesh transform in the uniform buffer.
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 color;
+
+    static const uint32_t BINDING = 1;
+
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding      = BINDING;
+        bindingDescription.stride       = sizeof(InstanceData);
+        bindingDescription.inputRate    = VK_VERTEX_INPUT_RATE_INSTANCE;
+        return bindingDescription;
+    }
+
+    // Locations 2-5 hold the model matrix columns, 6 the color (see shader.vert)
+    static std::array<VkVertexInputAttributeDescription, 5> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions{};
+        for (uint32_t i = 0; i < 4; i++) {
+            attributeDescriptions[i].binding    = BINDING;
+            attributeDescriptions[i].location   = 2 + i;
+            attributeDescriptions[i].format     = VK_FORMAT_R32G32B32A32_SFLOAT;
+            attributeDescriptions[i].offset     = static_cast<uint32_t>(offsetof(InstanceData, model) + i * sizeof(glm::vec4));
+        }
+        attributeDescriptions[4].binding    = BINDING;
+        attributeDescriptions[4].location   = 6;
+        attributeDescriptions[4].format     = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[4].offset     = offsetof(InstanceData, color);
+        return attributeDescriptions;
+    }
+};
+
+// Where the instances are placed, a point p of the mesh ends up within maxLinearDeviation * |p| of the translation
+// box shifted by p
+struct InstanceBounds {
+    glm::vec3   min;                    // Of the translations
+    glm::vec3   max;
+    float       maxLinearDeviation;     // Largest Frobenius norm of an upper 3x3 minus identity, 0 for pure translations
+};
+
+// Stable reference to an instance, stays valid while other instances are added and removed
+using InstanceHandle = uint32_t;
+
+// Densely packed instance array with dirty tracking per frame in flight
+// Removal moves the last instance into the hole so the array never has gaps and draws stay a single instanced call.
+// Changes mark fixed-size pages dirty in every frame's copy, writeDirty then copies only the dirty pages of one
+// frame into its mapped buffer, coalescing neighbouring pages into one memcpy.
+class InstanceSet
+{
+public:
+    static const uint32_t PAGE_INSTANCES = 64;
+
+    explicit InstanceSet(uint32_t frameCount = 1);
+
+    InstanceHandle add(const InstanceData& instance);
+    void remove(InstanceHandle handle);
+    void update(InstanceHandle handle, const InstanceData& instance);
+    const InstanceData& get(InstanceHandle handle) const { return instances[slotOfHandle[handle]]; }
+
+    uint32_t            count() const { return static_cast<uint32_t>(instances.size()); }
+    const InstanceData* data() const { return instances.data(); }
+    // Recomputed on the first call after a change, so it is free on frames where nothing moved
+    const InstanceBounds& bounds() const;
+
+    // Marks everything dirty for one frame, used after its buffer was reallocated
+    void invalidate(uint32_t frame);
+    // Copies every instance that changed since the last call for this frame into dst (instance 0 at dst), returns bytes written
+    size_t writeDirty(uint32_t frame, void* dst);
+
+private:
+    void markDirty(uint32_t slot);
+
+    std::vector<InstanceData>           instances;
+    std::vector<InstanceHandle>         handleOfSlot;
+    std::vector<uint32_t>               slotOfHandle;
+    std::vector<InstanceHandle>         freeHandles;
+    // One bit per page and frame
+    std::vector<std::vector<uint64_t>>  dirtyPages;
+    mutable InstanceBounds              cachedBounds{};
+    mutable bool                        boundsStale     = true;
+};
@@ -0,0 +1,290 @@
+#include "MemoryAllocator.h"
+
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include <vulkan/vk_enum_string_helper.h>
+
+static uint32_t orderForSize(VkDeviceSize size)
+{
+    uint32_t order = MEMORY_MIN_ALLOCATION_ORDER;
+    while ((VkDeviceSize(1) << order) < size) {
+        order++;
+    }
+    return order;
+}
+
+void MemoryAllocator::init(VkPhysicalDevice physicalDevice, VkDevice device)
+{
+    this->device = device;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    bufferImageGranularity      = properties.limits.bufferImageGranularity;
+    nonCoherentAtomSize         = properties.limits.nonCoherentAtomSize;
+    maxMemoryAllocationCount    = properties.limits.maxMemoryAllocationCount;
+
+    // Small heaps (e.g. the 256 MB host-visible device-local window) get smaller blocks so one block can't starve them
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size;
+        VkDeviceSize blockSize = MEMORY_BLOCK_SIZE;
+        while (blockSize > heapSize / 8 && blockSize > (VkDeviceSize(1) << 20)) {
+            blockSize /= 2;
+        }
+        blockSizes[i] = blockSize;
+    }
+
+    std::cout << "[MEMORY] " << memoryProperties.memoryTypeCount << " Memory Types, " << memoryProperties.memoryHeapCount << " Heaps, "
+              << "bufferImageGranularity " << bufferImageGranularity << ", maxMemoryAllocationCount " << maxMemoryAllocationCount << std::endl;
+}
+
+void MemoryAllocator::destroy()
+{
+    for (auto& kinds : pools) {
+        for (auto& blocks : kinds) {
+            for (auto& block : blocks) {
+                if (block->allocationCount > 0) {
+                    std::cout << "[MEMORY] WARNING: " << block->allocationCount << " allocations leaked in memory type " << block->memoryType << std::endl;
+                }
+                vkFreeMemory(device, block->memory, nullptr);
+            }
+            blocks.clear();
+        }
+    }
+    deviceAllocationCount = 0;
+    memoryStats = {};
+}
+
+int32_t MemoryAllocator::findMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return static_cast<int32_t>(i);
+        }
+    }
+    return -1;
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+    int32_t memoryType = findMemoryTypeIndex(typeFilter, properties);
+    if (memoryType < 0) {
+        throw std::runtime_error("[Vulkan] Failed to find suitable Memory Type");
+    }
+    return static_cast<uint32_t>(memoryType);
+}
+
+VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void** mapped)
+{
+    if (deviceAllocationCount >= maxMemoryAllocationCount) {
+        std::cout << "[MEMORY] WARNING: " << deviceAllocationCount << " device allocations, maxMemoryAllocationCount is " << maxMemoryAllocationCount << std::endl;
+    }
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType             = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize    = size;
+    allocInfo.memoryTypeIndex   = memoryType;
+
+    VkDeviceMemory memory;
+    VkResult result = vkAllocateMemory(device, &allocInfo, nullptr, &memory);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to allocate Device Memory");
+    }
+    deviceAllocationCount++;
+    memoryStats[memoryType].reservedBytes += size;
+
+    *mapped = nullptr;
+    if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        result = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+        if (result != VK_SUCCESS) {
+            std::cerr << string_VkResult(result) << std::endl;
+            throw std::runtime_error("[VULKAN] Failed to map Device Memory");
+        }
+    }
+    return memory;
+}
+
+MemoryBlock* MemoryAllocator::createBlock(uint32_t memoryType, AllocationKind kind)
+{
+    auto block = std::make_unique<MemoryBlock>();
+    block->size             = blockSizes[memoryType];
+    block->memoryType       = memoryType;
+    block->kind             = kind;
+    block->maxOrder         = orderForSize(block->size);
+    block->allocationCount  = 0;
+    block->memory           = allocateDeviceMemory(block->size, memoryType, &block->mapped);
+    block->freeLists.resize(block->maxOrder - MEMORY_MIN_ALLOCATION_ORDER + 1);
+    block->freeLists.back().insert(0);
+    memoryStats[memoryType].blockCount++;
+
+    pools[memoryType][kind].push_back(std::move(block));
+    return pools[memoryType][kind].back().get();
+}
+
+void MemoryAllocator::destroyBlock(MemoryBlock* block)
+{
+    std::vector<std::unique_ptr<MemoryBlock>>& blocks = pools[block->memoryType][block->kind];
+    auto it = std::find_if(blocks.begin(), blocks.end(), [&](const std::unique_ptr<MemoryBlock>& b) { return b.get() == block; });
+    memoryStats[block->memoryType].blockCount--;
+    memoryStats[block->memoryType].reservedBytes -= block->size;
+    deviceAllocationCount--;
+    vkFreeMemory(device, block->memory, nullptr);
+    blocks.erase(it);
+}
+
+// Takes the smallest free node that fits and splits it down to the requested order, the upper halves become free nodes
+static bool allocateFromBlock(MemoryBlock& block, uint32_t order, VkDeviceSize& offset)
+{
+    uint32_t freeOrder = order;
+    while (freeOrder <= block.maxOrder && block.freeLists[freeOrder - MEMORY_MIN_ALLOCATION_ORDER].empty()) {
+        freeOrder++;
+    }
+    if (freeOrder > block.maxOrder) {
+        return false;
+    }
+
+    std::set<VkDeviceSize>& freeList = block.freeLists[freeOrder - MEMORY_MIN_ALLOCATION_ORDER];
+    offset = *freeList.begin();
+    freeList.erase(freeList.begin());
+    while (freeOrder > order) {
+        freeOrder--;
+        block.freeLists[freeOrder - MEMORY_MIN_ALLOCATION_ORDER].insert(offset + (VkDeviceSize(1) << freeOrder));
+    }
+    block.allocationCount++;
+    return true;
+}
+
+MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, AllocationKind kind, bool dedicated,
+                                           VkMemoryPropertyFlags preferredProperties)
+{
+    MemoryAllocation allocation{};
+    int32_t preferredType   = preferredProperties ? findMemoryTypeIndex(requirements.memoryTypeBits, properties | preferredProperties) : -1;
+    allocation.memoryType   = preferredType >= 0 ? static_cast<uint32_t>(preferredType) : findMemoryType(requirements.memoryTypeBits, properties);
+    allocation.size         = requirements.size;
+
+    VkMemoryPropertyFlags typeFlags = memoryProperties.memoryTypes[allocation.memoryType].propertyFlags;
+    VkDeviceSize alignment = requirements.alignment;
+    // Flushes of non-coherent memory work in whole atoms, keep neighbours out of each other's atoms
+    if ((typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+        alignment = std::max(alignment, nonCoherentAtomSize);
+    }
+    if (bufferImageGranularity <= 1) {
+        kind = ALLOCATION_KIND_LINEAR;
+    }
+
+    MemoryStats& typeStats = memoryStats[allocation.memoryType];
+    VkDeviceSize blockSize = blockSizes[allocation.memoryType];
+    if (dedicated || std::max(requirements.size, alignment) > blockSize / 2) {
+        void* mapped;
+        allocation.memory   = allocateDeviceMemory(requirements.size, allocation.memoryType, &mapped);
+        allocation.mapped   = mapped;
+        typeStats.dedicatedCount++;
+        typeStats.allocationCount++;
+        typeStats.usedBytes += allocation.size;
+        return allocation;
+    }
+
+    allocation.order = orderForSize(std::max(requirements.size, alignment));
+    MemoryBlock* block = nullptr;
+    for (auto& candidate : pools[allocation.memoryType][kind]) {
+        if (allocateFromBlock(*candidate, allocation.order, allocation.offset)) {
+            block = candidate.get();
+            break;
+        }
+    }
+    if (block == nullptr) {
+        block = createBlock(allocation.memoryType, kind);
+        allocateFromBlock(*block, allocation.order, allocation.offset);
+    }
+
+    allocation.block    = block;
+    allocation.memory   = block->memory;
+    allocation.mapped   = block->mapped ? static_cast<char*>(block->mapped) + allocation.offset : nullptr;
+    typeStats.allocationCount++;
+    typeStats.usedBytes += allocation.size;
+    typeStats.roundingBytes += (VkDeviceSize(1) << allocation.order) - allocation.size;
+    return allocation;
+}
+
+void MemoryAllocator::free(MemoryAllocation& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    MemoryStats& typeStats = memoryStats[allocation.memoryType];
+    typeStats.allocationCount--;
+    typeStats.usedBytes -= allocation.size;
+
+    if (allocation.block == nullptr) {
+        typeStats.dedicatedCount--;
+        typeStats.reservedBytes -= allocation.size;
+        deviceAllocationCount--;
+        vkFreeMemory(device, allocation.memory, nullptr);
+        allocation = {};
+        return;
+    }
+
+    typeStats.roundingBytes -= (VkDeviceSize(1) << allocation.order) - allocation.size;
+
+    // Merge with the buddy for as long as it is free as well
+    MemoryBlock& block = *allocation.block;
+    VkDeviceSize offset = allocation.offset;
+    uint32_t order = allocation.order;
+    while (order < block.maxOrder) {
+        VkDeviceSize buddy = offset ^ (VkDeviceSize(1) << order);
+        if (block.freeLists[order - MEMORY_MIN_ALLOCATION_ORDER].erase(buddy) == 0) {
+            break;
+        }
+        offset = std::min(offset, buddy);
+        order++;
+    }
+    block.freeLists[order - MEMORY_MIN_ALLOCATION_ORDER].insert(offset);
+    block.allocationCount--;
+
+    // Keep one empty block per pool around so alloc/free churn doesn't hit vkAllocateMemory every time
+    if (block.allocationCount == 0 && pools[block.memoryType][block.kind].size() > 1) {
+        destroyBlock(&block);
+    }
+    allocation = {};
+}
+
+MemoryStats MemoryAllocator::stats(uint32_t memoryType) const
+{
+    return memoryStats[memoryType];
+}
+
+MemoryStats MemoryAllocator::totalStats() const
+{
+    MemoryStats total{};
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        total.blockCount        += memoryStats[i].blockCount;
+        total.dedicatedCount    += memoryStats[i].dedicatedCount;
+        total.allocationCount   += memoryStats[i].allocationCount;
+        total.reservedBytes     += memoryStats[i].reservedBytes;
+        total.usedBytes         += memoryStats[i].usedBytes;
+        total.roundingBytes     += memoryStats[i].roundingBytes;
+    }
+    return total;
+}
+
+void MemoryAllocator::logStats() const
+{
+    MemoryStats total = totalStats();
+    std::cout << "[MEMORY] " << total.allocationCount << " allocations in " << deviceAllocationCount << " device allocations ("
+              << total.blockCount << " blocks, " << total.dedicatedCount << " dedicated), "
+              << total.usedBytes / 1024 << " KB used of " << total.reservedBytes / 1024 << " KB reserved" << std::endl;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        const MemoryStats& typeStats = memoryStats[i];
+        if (typeStats.reservedBytes == 0) {
+            continue;
+        }
+        std::cout << "[MEMORY]   Type " << i << " (heap " << memoryProperties.memoryTypes[i].heapIndex << "): "
+                  << typeStats.allocationCount << " allocations, " << typeStats.blockCount << " blocks of " << blockSizes[i] / 1024 << " KB, "
+                  << typeStats.dedicatedCount << " dedicated, " << typeStats.usedBytes / 1024 << " KB used, "
+                  << typeStats.roundingBytes / 1024 << " KB rounding" << std::endl;
+    }
+}
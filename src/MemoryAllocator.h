@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <set>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+// Device memory sub-allocator
+// Each memory type owns a list of large blocks from vkAllocateMemory, carved up with a binary buddy scheme. A buddy
+// node of size 2^k always sits at a multiple of 2^k inside its block, so rounding a request up to a power of two that
+// is at least its alignment satisfies the alignment for free. Buffers and optimal-tiling images live in separate
+// blocks whenever the device reports a bufferImageGranularity above 1, so they can never share a granularity page.
+// Host-visible blocks are mapped once for their whole lifetime, MemoryAllocation::mapped points at the sub-range.
+const VkDeviceSize MEMORY_BLOCK_SIZE            = 64ull * 1024 * 1024;
+const uint32_t     MEMORY_MIN_ALLOCATION_ORDER  = 8;   // 256 bytes, smallest buddy node
+
+enum AllocationKind : uint32_t {
+    ALLOCATION_KIND_LINEAR = 0,     // Buffers and linear-tiling images
+    ALLOCATION_KIND_OPTIMAL,        // Optimal-tiling images
+    ALLOCATION_KIND_COUNT
+};
+
+// One vkAllocateMemory carved into buddy nodes
+struct MemoryBlock {
+    VkDeviceMemory                      memory;
+    void*                               mapped;
+    VkDeviceSize                        size;
+    uint32_t                            memoryType;
+    AllocationKind                      kind;
+    uint32_t                            maxOrder;
+    uint32_t                            allocationCount;
+    // Offsets of free buddy nodes, indexed by order - MEMORY_MIN_ALLOCATION_ORDER
+    std::vector<std::set<VkDeviceSize>> freeLists;
+};
+
+struct MemoryAllocation {
+    VkDeviceMemory  memory      = VK_NULL_HANDLE;
+    VkDeviceSize    offset      = 0;
+    VkDeviceSize    size        = 0;                // Requested size, the buddy node may be larger
+    void*           mapped      = nullptr;          // Host pointer to offset for host-visible memory
+    uint32_t        memoryType  = 0;
+    uint32_t        order       = 0;                // log2 of the buddy node size, 0 for dedicated allocations
+    MemoryBlock*    block       = nullptr;          // nullptr for dedicated allocations
+};
+
+struct MemoryStats {
+    uint32_t        blockCount;
+    uint32_t        dedicatedCount;
+    uint32_t        allocationCount;                // Live sub-allocations and dedicated allocations
+    VkDeviceSize    reservedBytes;                  // Total size of every vkAllocateMemory
+    VkDeviceSize    usedBytes;                      // Total requested size of live allocations
+    VkDeviceSize    roundingBytes;                  // Lost to power of two rounding of sub-allocations
+};
+
+class MemoryAllocator
+{
+public:
+    MemoryAllocator() = default;
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+    void init(VkPhysicalDevice physicalDevice, VkDevice device);
+    // Frees every block, all allocations must have been released already
+    void destroy();
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+    // Requests larger than half a block always get their own VkDeviceMemory, dedicated forces that for smaller ones.
+    // preferredProperties are added to properties when a memory type has them all, e.g. DEVICE_LOCAL for host-written buffers.
+    MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, AllocationKind kind, bool dedicated = false,
+                              VkMemoryPropertyFlags preferredProperties = 0);
+    void free(MemoryAllocation& allocation);
+
+    MemoryStats stats(uint32_t memoryType) const;
+    MemoryStats totalStats() const;
+    void logStats() const;
+
+private:
+    int32_t findMemoryTypeIndex(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+    MemoryBlock* createBlock(uint32_t memoryType, AllocationKind kind);
+    void destroyBlock(MemoryBlock* block);
+    VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void** mapped);
+
+    VkDevice                            device                      = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties    memoryProperties{};
+    VkDeviceSize                        bufferImageGranularity      = 1;
+    VkDeviceSize                        nonCoherentAtomSize         = 1;
+    uint32_t                            maxMemoryAllocationCount    = 0;
+    uint32_t                            deviceAllocationCount       = 0;
+    std::array<VkDeviceSize, VK_MAX_MEMORY_TYPES>                                                               blockSizes{};
+    std::array<std::array<std::vector<std::unique_ptr<MemoryBlock>>, ALLOCATION_KIND_COUNT>, VK_MAX_MEMORY_TYPES> pools;
+    std::array<MemoryStats, VK_MAX_MEMORY_TYPES>                                                                memoryStats{};
+};
@@ -0,0 +1,584 @@
+#include "Mesh.h"
+
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <limits>
+
+VertexLayout VertexLayout::get(VertexFormat format)
+{
+    switch (format) {
+        case VERTEX_FORMAT_OCT16:   return { format, sizeof(PackedVertexOct16) };
+        case VERTEX_FORMAT_OCT8:    return { format, sizeof(PackedVertexOct8) };
+        default:                    return { VERTEX_FORMAT_FLOAT32, sizeof(Vertex) };
+    }
+}
+
+VkVertexInputBindingDescription VertexLayout::getBindingDescription() const
+{
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding      = 0;
+    bindingDescription.stride       = stride;
+    bindingDescription.inputRate    = VK_VERTEX_INPUT_RATE_VERTEX;
+    return bindingDescription;
+}
+
+std::vector<VkVertexInputAttributeDescription> VertexLayout::getAttributeDescriptions() const
+{
+    if (format == VERTEX_FORMAT_FLOAT32) {
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions = Vertex::getAttributeDescriptions();
+        return { attributeDescriptions.begin(), attributeDescriptions.end() };
+    }
+
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions(2);
+    attributeDescriptions[0].binding    = 0;
+    attributeDescriptions[0].location   = 0;
+    attributeDescriptions[0].format     = VK_FORMAT_R16G16B16A16_UNORM;
+    attributeDescriptions[0].offset     = 0;
+    attributeDescriptions[1].binding    = 0;
+    attributeDescriptions[1].location   = 1;
+    if (format == VERTEX_FORMAT_OCT16) {
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+        attributeDescriptions[1].offset = offsetof(PackedVertexOct16, normal);
+    }
+    else {
+        // Metal needs 4-byte aligned attribute offsets, so the normal is fetched as the zw of an RGBA8 at offset 4
+        // (xy overlap pos[2]) and the position's w reads the normal bytes, shader.vert ignores both
+        attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_SNORM;
+        attributeDescriptions[1].offset = 4;
+    }
+    return attributeDescriptions;
+}
+
+const char* vertexFormatName(VertexFormat format)
+{
+    switch (format) {
+        case VERTEX_FORMAT_FLOAT32: return "float32";
+        case VERTEX_FORMAT_OCT16:   return "oct16";
+        case VERTEX_FORMAT_OCT8:    return "oct8";
+        default:                    return "unknown";
+    }
+}
+
+bool parseVertexFormat(const std::string& name, VertexFormat& format)
+{
+    for (uint32_t i = 0; i < VERTEX_FORMAT_COUNT; i++) {
+        if (name == vertexFormatName(static_cast<VertexFormat>(i))) {
+            format = static_cast<VertexFormat>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+MeshBounds computeBounds(const Vertex* vertices, size_t vertexCount)
+{
+    MeshBounds bounds{ glm::vec3(0.0f), glm::vec3(0.0f) };
+    if (vertexCount > 0) {
+        bounds.min = bounds.max = vertices[0].pos;
+    }
+    for (size_t i = 1; i < vertexCount; i++) {
+        bounds.min = glm::min(bounds.min, vertices[i].pos);
+        bounds.max = glm::max(bounds.max, vertices[i].pos);
+    }
+    return bounds;
+}
+
+static inline uint16_t quantizeUnorm16(float value)
+{
+    return static_cast<uint16_t>(std::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+template <typename T>
+static inline T quantizeSnorm(float value)
+{
+    const float scale = static_cast<float>(std::numeric_limits<T>::max());
+    return static_cast<T>(std::round(std::clamp(value, -1.0f, 1.0f) * scale));
+}
+
+// Octahedral normal encoding (Cigolle et al., "A Survey of Efficient Representations for Independent Unit Vectors")
+static glm::vec2 octEncode(glm::vec3 normal)
+{
+    float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (l1 == 0.0f) {
+        return glm::vec2(0.0f);
+    }
+    normal /= l1;
+    if (normal.z < 0.0f) {
+        float x = normal.x, y = normal.y;
+        normal.x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        normal.y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return glm::vec2(normal.x, normal.y);
+}
+
+void packVertices(VertexFormat format, const Vertex* vertices, size_t vertexCount, const MeshBounds& bounds, void* dst)
+{
+    if (format == VERTEX_FORMAT_FLOAT32) {
+        memcpy(dst, vertices, vertexCount * sizeof(Vertex));
+        return;
+    }
+
+    glm::vec3 extent = bounds.max - bounds.min;
+    glm::vec3 inverseExtent(
+        extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+        extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+        extent.z > 0.0f ? 1.0f / extent.z : 0.0f
+    );
+
+    for (size_t i = 0; i < vertexCount; i++) {
+        glm::vec3 position = (vertices[i].pos - bounds.min) * inverseExtent;
+        glm::vec2 normal = octEncode(vertices[i].color);
+        if (format == VERTEX_FORMAT_OCT16) {
+            PackedVertexOct16& packed = static_cast<PackedVertexOct16*>(dst)[i];
+            packed.pos[0]       = quantizeUnorm16(position.x);
+            packed.pos[1]       = quantizeUnorm16(position.y);
+            packed.pos[2]       = quantizeUnorm16(position.z);
+            packed.pos[3]       = 0;
+            packed.normal[0]    = quantizeSnorm<int16_t>(normal.x);
+            packed.normal[1]    = quantizeSnorm<int16_t>(normal.y);
+        }
+        else {
+            PackedVertexOct8& packed = static_cast<PackedVertexOct8*>(dst)[i];
+            packed.pos[0]       = quantizeUnorm16(position.x);
+            packed.pos[1]       = quantizeUnorm16(position.y);
+            packed.pos[2]       = quantizeUnorm16(position.z);
+            packed.normal[0]    = quantizeSnorm<int8_t>(normal.x);
+            packed.normal[1]    = quantizeSnorm<int8_t>(normal.y);
+        }
+    }
+}
+
+void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    // Weld the per-corner vertices and reorder for the post-transform cache and vertex fetch
+    VertexCacheStats before = analyzeVertexCache(indices, vertices.size());
+    size_t vertexCountBefore = vertices.size();
+    weldVertices(vertices, indices);
+    optimizeVertexCache(indices, vertices.size());
+    optimizeVertexFetch(vertices, indices);
+    VertexCacheStats after = analyzeVertexCache(indices, vertices.size());
+
+    std::cout << "[MESH] Optimized " << indices.size() / 3 << " triangles" << std::endl;
+    std::cout << "[MESH]   Vertices:       " << vertexCountBefore << " -> " << vertices.size() << std::endl;
+    std::cout << "[MESH]   Vertex Buffer:  " << vertexCountBefore * sizeof(Vertex) << " -> " << vertices.size() * sizeof(Vertex) << " bytes" << std::endl;
+    std::cout << "[MESH]   ACMR:           " << before.acmr << " -> " << after.acmr << std::endl;
+    std::cout << "[MESH]   ATVR:           " << before.atvr << " -> " << after.atvr << std::endl;
+    std::cout << "[MESH]   VS Invocations: " << before.transformedVertices << " -> " << after.transformedVertices << std::endl;
+}
+
+// Welding compares raw bit patterns, -0.0f is folded into 0.0f so hash and equality agree
+struct VertexKey {
+    uint32_t bits[6];
+
+    explicit VertexKey(const Vertex& vertex) {
+        const float components[6] = {
+            vertex.pos.x   + 0.0f, vertex.pos.y   + 0.0f, vertex.pos.z   + 0.0f,
+            vertex.color.x + 0.0f, vertex.color.y + 0.0f, vertex.color.z + 0.0f
+        };
+        memcpy(bits, components, sizeof(bits));
+    }
+
+    bool operator==(const VertexKey& other) const {
+        return memcmp(bits, other.bits, sizeof(bits)) == 0;
+    }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const {
+        // FNV-1a over the six components
+        uint64_t hash = 14695981039346656037ull;
+        for (uint32_t bits : key.bits) {
+            hash ^= bits;
+            hash *= 1099511628211ull;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+size_t weldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> uniqueVertices;
+    uniqueVertices.reserve(vertices.size());
+
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        auto [it, inserted] = uniqueVertices.try_emplace(VertexKey(vertices[i]), static_cast<uint32_t>(welded.size()));
+        if (inserted) {
+            welded.push_back(vertices[i]);
+        }
+        remap[i] = it->second;
+    }
+
+    for (uint32_t& index : indices) {
+        index = remap[index];
+    }
+    vertices.swap(welded);
+    return vertices.size();
+}
+
+// Forsyth scoring constants, the simulated LRU cache is larger than real hardware on purpose
+static const int    kCacheSize          = 32;
+static const float  kCacheDecayPower    = 1.5f;
+static const float  kLastTriangleScore  = 0.75f;
+static const float  kValenceBoostScale  = 2.0f;
+static const float  kValenceBoostPower  = 0.5f;
+
+static float vertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+    if (remainingTriangles == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // The three vertices of the last emitted triangle get a fixed score so strips are not favoured over fans
+            score = kLastTriangleScore;
+        }
+        else {
+            const float scaler = 1.0f / (kCacheSize - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scaler, kCacheDecayPower);
+        }
+    }
+    // Boost vertices with few triangles left so lone triangles do not get stranded
+    score += kValenceBoostScale * std::pow(static_cast<float>(remainingTriangles), -kValenceBoostPower);
+    return score;
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Vertex -> triangle adjacency in CSR form
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (uint32_t index : indices) {
+        adjacencyOffsets[index + 1]++;
+    }
+    for (size_t i = 0; i < vertexCount; i++) {
+        adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+    }
+    std::vector<uint32_t> remainingTriangles(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        remainingTriangles[i] = adjacencyOffsets[i + 1] - adjacencyOffsets[i];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        vertexScores[i] = vertexScore(-1, remainingTriangles[i]);
+    }
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScores[t] = vertexScores[indices[t * 3 + 0]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    // cache holds kCacheSize entries plus room for the 3 vertices pushed by the current triangle
+    std::vector<uint32_t> cache, nextCache;
+    cache.reserve(kCacheSize + 3);
+    nextCache.reserve(kCacheSize + 3);
+
+    size_t scanCursor = 0;
+    int64_t bestTriangle = -1;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        if (bestTriangle < 0) {
+            // Nothing adjacent to the cache is left, resume a linear scan for the next unemitted triangle
+            while (emitted[scanCursor]) {
+                scanCursor++;
+            }
+            bestTriangle = static_cast<int64_t>(scanCursor);
+        }
+
+        const uint32_t triangle = static_cast<uint32_t>(bestTriangle);
+        const uint32_t corners[3] = { indices[triangle * 3 + 0], indices[triangle * 3 + 1], indices[triangle * 3 + 2] };
+        output.insert(output.end(), corners, corners + 3);
+        emitted[triangle] = true;
+
+        // Remove the triangle from its vertices' adjacency lists
+        for (int k = 0; k < 3; k++) {
+            uint32_t vertex = corners[k];
+            uint32_t* begin = &adjacency[adjacencyOffsets[vertex]];
+            uint32_t* end = begin + remainingTriangles[vertex];
+            uint32_t* found = std::find(begin, end, triangle);
+            std::swap(*found, *(end - 1));
+            remainingTriangles[vertex]--;
+        }
+
+        // Push the triangle's vertices to the front of the LRU cache
+        nextCache.clear();
+        nextCache.insert(nextCache.end(), corners, corners + 3);
+        for (uint32_t vertex : cache) {
+            if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2]) {
+                nextCache.push_back(vertex);
+            }
+        }
+
+        // Rescore everything that was in the cache, including vertices that just fell out of it
+        for (size_t i = 0; i < nextCache.size(); i++) {
+            uint32_t vertex = nextCache[i];
+            int position = i < kCacheSize ? static_cast<int>(i) : -1;
+            float newScore = vertexScore(position, remainingTriangles[vertex]);
+            float delta = newScore - vertexScores[vertex];
+            vertexScores[vertex] = newScore;
+
+            const uint32_t* begin = &adjacency[adjacencyOffsets[vertex]];
+            for (uint32_t j = 0; j < remainingTriangles[vertex]; j++) {
+                triangleScores[begin[j]] += delta;
+            }
+        }
+
+        // Next triangle is the best one touching the cache
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < nextCache.size() && i < kCacheSize; i++) {
+            uint32_t vertex = nextCache[i];
+            const uint32_t* begin = &adjacency[adjacencyOffsets[vertex]];
+            for (uint32_t j = 0; j < remainingTriangles[vertex]; j++) {
+                if (triangleScores[begin[j]] > bestScore) {
+                    bestScore = triangleScores[begin[j]];
+                    bestTriangle = begin[j];
+                }
+            }
+        }
+        if (nextCache.size() > kCacheSize) {
+            nextCache.resize(kCacheSize);
+        }
+        cache.swap(nextCache);
+    }
+
+    indices.swap(output);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    const uint32_t unused = UINT32_MAX;
+    std::vector<uint32_t> remap(vertices.size(), unused);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (uint32_t& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<uint32_t>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    // Vertices not referenced by any triangle are dropped
+    vertices.swap(reordered);
+}
+
+std::vector<SubMesh> splitSubMeshes(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods, uint32_t maxVertices)
+{
+    std::vector<SubMesh> subMeshes;
+    if (vertices.size() <= maxVertices) {
+        for (MeshLod& lod : lods) {
+            lod.firstSubMesh = static_cast<uint32_t>(subMeshes.size());
+            lod.subMeshCount = 1;
+            subMeshes.push_back(SubMesh{ lod.firstIndex, lod.indexCount, 0, static_cast<uint32_t>(vertices.size()) });
+        }
+        return subMeshes;
+    }
+
+    const uint32_t unassigned = UINT32_MAX;
+    std::vector<uint32_t> localIndex(vertices.size(), unassigned);
+    std::vector<uint32_t> subMeshOf(vertices.size(), unassigned);
+    std::vector<Vertex> splitVertices;
+    splitVertices.reserve(vertices.size() + vertices.size() / 8);
+
+    for (MeshLod& lod : lods) {
+        lod.firstSubMesh = static_cast<uint32_t>(subMeshes.size());
+        SubMesh current{ lod.firstIndex, 0, static_cast<int32_t>(splitVertices.size()), 0 };
+        for (size_t triangle = lod.firstIndex / 3; triangle < (lod.firstIndex + lod.indexCount) / 3; triangle++) {
+            const uint32_t corners[3] = { indices[triangle * 3 + 0], indices[triangle * 3 + 1], indices[triangle * 3 + 2] };
+            uint32_t subMeshIndex = static_cast<uint32_t>(subMeshes.size());
+            uint32_t newVertices = 0;
+            for (int k = 0; k < 3; k++) {
+                bool duplicateCorner = (k > 0 && corners[k] == corners[0]) || (k > 1 && corners[k] == corners[1]);
+                newVertices += subMeshOf[corners[k]] != subMeshIndex && !duplicateCorner;
+            }
+            if (current.vertexCount + newVertices > maxVertices) {
+                subMeshes.push_back(current);
+                subMeshIndex++;
+                current = SubMesh{ static_cast<uint32_t>(triangle * 3), 0, static_cast<int32_t>(splitVertices.size()), 0 };
+            }
+
+            for (int k = 0; k < 3; k++) {
+                uint32_t vertex = corners[k];
+                if (subMeshOf[vertex] != subMeshIndex) {
+                    subMeshOf[vertex] = subMeshIndex;
+                    localIndex[vertex] = current.vertexCount++;
+                    splitVertices.push_back(vertices[vertex]);
+                }
+            }
+            for (int k = 0; k < 3; k++) {
+                indices[triangle * 3 + k] = localIndex[corners[k]];
+            }
+            current.indexCount += 3;
+        }
+        subMeshes.push_back(current);
+        lod.subMeshCount = static_cast<uint32_t>(subMeshes.size()) - lod.firstSubMesh;
+    }
+
+    std::cout << "[MESH] Split into " << subMeshes.size() << " sub-meshes for 16-bit indices: " << vertices.size() << " -> "
+              << splitVertices.size() << " vertices" << std::endl;
+    vertices.swap(splitVertices);
+    return subMeshes;
+}
+
+static void computeMeshletBounds(Meshlet& meshlet, const Vertex* vertices, const uint32_t* indices)
+{
+    glm::vec3 boundsMin = vertices[indices[0]].pos;
+    glm::vec3 boundsMax = boundsMin;
+    for (uint32_t i = 1; i < meshlet.indexCount; i++) {
+        boundsMin = glm::min(boundsMin, vertices[indices[i]].pos);
+        boundsMax = glm::max(boundsMax, vertices[indices[i]].pos);
+    }
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < meshlet.indexCount; i++) {
+        radius = std::max(radius, glm::length(vertices[indices[i]].pos - center));
+    }
+
+    // Normal cone from the geometric triangle normals (counter-clockwise front faces, like the pipeline)
+    std::array<glm::vec3, MESHLET_MAX_TRIANGLES> normals;
+    uint32_t normalCount = 0;
+    glm::vec3 axis(0.0f);
+    for (uint32_t i = 0; i + 2 < meshlet.indexCount; i += 3) {
+        glm::vec3 a = vertices[indices[i + 0]].pos;
+        glm::vec3 b = vertices[indices[i + 1]].pos;
+        glm::vec3 c = vertices[indices[i + 2]].pos;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float area = glm::length(normal);
+        if (area > 0.0f) {
+            normals[normalCount++] = normal / area;
+            axis += normal / area;
+        }
+    }
+
+    float axisLength = glm::length(axis);
+    float minDot = 1.0f;
+    if (axisLength > 0.0f) {
+        axis /= axisLength;
+        for (uint32_t i = 0; i < normalCount; i++) {
+            minDot = std::min(minDot, glm::dot(axis, normals[i]));
+        }
+    }
+    else {
+        minDot = -1.0f;
+    }
+
+    for (int k = 0; k < 3; k++) {
+        meshlet.center[k] = center[k];
+        meshlet.coneAxis[k] = axis[k];
+    }
+    meshlet.radius = radius;
+    // Cones wider than a hemisphere can never be back-facing as a whole
+    meshlet.coneCutoff = minDot <= 0.0f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+}
+
+static void appendMeshlets(std::vector<Meshlet>& meshlets, std::vector<uint32_t>& lastMeshlet, const Vertex* vertices,
+                           const std::vector<uint32_t>& indices, const SubMesh& subMesh)
+{
+    const Vertex* subMeshVertices = vertices + subMesh.vertexOffset;
+    Meshlet current{};
+    current.firstIndex = subMesh.firstIndex;
+    current.vertexOffset = subMesh.vertexOffset;
+    uint32_t vertexCount = 0;
+
+    for (uint32_t i = subMesh.firstIndex; i < subMesh.firstIndex + subMesh.indexCount; i += 3) {
+        uint32_t meshletIndex = static_cast<uint32_t>(meshlets.size());
+        uint32_t newVertices = 0;
+        for (int k = 0; k < 3; k++) {
+            bool duplicateCorner = (k > 0 && indices[i + k] == indices[i]) || (k > 1 && indices[i + k] == indices[i + 1]);
+            newVertices += lastMeshlet[subMesh.vertexOffset + indices[i + k]] != meshletIndex && !duplicateCorner;
+        }
+        if (vertexCount + newVertices > MESHLET_MAX_VERTICES || current.indexCount / 3 == MESHLET_MAX_TRIANGLES) {
+            computeMeshletBounds(current, subMeshVertices, &indices[current.firstIndex]);
+            meshlets.push_back(current);
+            meshletIndex++;
+            current.firstIndex = i;
+            current.indexCount = 0;
+            vertexCount = 0;
+        }
+        for (int k = 0; k < 3; k++) {
+            uint32_t& last = lastMeshlet[subMesh.vertexOffset + indices[i + k]];
+            if (last != meshletIndex) {
+                last = meshletIndex;
+                vertexCount++;
+            }
+        }
+        current.indexCount += 3;
+    }
+    if (current.indexCount > 0) {
+        computeMeshletBounds(current, subMeshVertices, &indices[current.firstIndex]);
+        meshlets.push_back(current);
+    }
+}
+
+std::vector<Meshlet> buildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<SubMesh>& subMeshes,
+                                   std::vector<MeshLod>& lods)
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> lastMeshlet(vertices.size(), UINT32_MAX);
+
+    for (MeshLod& lod : lods) {
+        lod.firstMeshlet = static_cast<uint32_t>(meshlets.size());
+        for (uint32_t i = lod.firstSubMesh; i < lod.firstSubMesh + lod.subMeshCount; i++) {
+            appendMeshlets(meshlets, lastMeshlet, vertices.data(), indices, subMeshes[i]);
+        }
+        lod.meshletCount = static_cast<uint32_t>(meshlets.size()) - lod.firstMeshlet;
+    }
+
+    std::cout << "[MESH] Built " << meshlets.size() << " meshlets, " << static_cast<float>(indices.size() / 3) / std::max<size_t>(meshlets.size(), 1)
+              << " triangles each on average" << std::endl;
+    return meshlets;
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+    VertexCacheStats stats{};
+    stats.triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+    // Timestamp FIFO, a vertex is a hit while it was inserted less than cacheSize misses ago
+    std::vector<uint32_t> insertedAt(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t misses = 0;
+    for (uint32_t index : indices) {
+        if (!referenced[index]) {
+            referenced[index] = true;
+            stats.vertexCount++;
+        }
+        if (misses - insertedAt[index] >= cacheSize || insertedAt[index] == 0) {
+            misses++;
+            insertedAt[index] = misses;
+        }
+    }
+    stats.transformedVertices = misses;
+
+    if (stats.triangleCount > 0) {
+        stats.acmr = static_cast<float>(misses) / stats.triangleCount;
+    }
+    if (stats.vertexCount > 0) {
+        stats.atvr = static_cast<float>(misses) / stats.vertexCount;
+    }
+    return stats;
+}
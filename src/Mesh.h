@@ -0,0 +1,174 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+struct Vertex {
+    glm::vec3 pos;
+    glm::vec3 color;
+
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding      = 0;
+        bindingDescription.stride       = sizeof(Vertex);
+        bindingDescription.inputRate    = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+        attributeDescriptions[0].binding    = 0;
+        attributeDescriptions[0].location   = 0;
+        attributeDescriptions[0].format     = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[0].offset     = offsetof(Vertex, pos);
+        attributeDescriptions[1].binding    = 0;
+        attributeDescriptions[1].location   = 1;
+        attributeDescriptions[1].format     = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[1].offset     = offsetof(Vertex, color);
+        return attributeDescriptions;
+    }
+};
+
+// GPU vertex layouts, selected at load time. Vertex above is the canonical layout stored in the mesh cache,
+// the packed layouts quantize positions to 16-bit UNORM relative to the mesh AABB and octahedral-encode normals.
+// Keep the values in sync with the VERTEX_FORMAT specialization constant in shader.vert.
+enum VertexFormat : uint32_t {
+    VERTEX_FORMAT_FLOAT32   = 0,    // 2x RGB32F
+    VERTEX_FORMAT_OCT16     = 1,    // RGBA16 UNORM position (w unused), RG16 SNORM normal, 12 bytes
+    VERTEX_FORMAT_OCT8      = 2,    // RGB16 UNORM position, RG8 SNORM normal, 8 bytes
+    VERTEX_FORMAT_COUNT
+};
+
+struct PackedVertexOct16 {
+    uint16_t    pos[4];
+    int16_t     normal[2];
+};
+
+struct PackedVertexOct8 {
+    uint16_t    pos[3];
+    int8_t      normal[2];
+};
+
+struct MeshBounds {
+    glm::vec3   min;
+    glm::vec3   max;
+};
+
+struct VertexLayout {
+    VertexFormat    format;
+    uint32_t        stride;
+
+    static VertexLayout get(VertexFormat format);
+
+    VkVertexInputBindingDescription getBindingDescription() const;
+    std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() const;
+};
+
+const char* vertexFormatName(VertexFormat format);
+bool parseVertexFormat(const std::string& name, VertexFormat& format);
+
+MeshBounds computeBounds(const Vertex* vertices, size_t vertexCount);
+// Converts canonical vertices into the given layout, dst must hold vertexCount * layout.stride bytes.
+// Packed positions are stored as (pos - bounds.min) / (bounds.max - bounds.min) and expanded again in shader.vert.
+void packVertices(VertexFormat format, const Vertex* vertices, size_t vertexCount, const MeshBounds& bounds, void* dst);
+
+// Range of the index buffer drawn with its own base vertex, indices are relative to vertexOffset
+struct SubMesh {
+    uint32_t    firstIndex;
+    uint32_t    indexCount;
+    int32_t     vertexOffset;
+    uint32_t    vertexCount;
+};
+
+// Largest vertex range a sub-mesh can address with 16-bit indices (primitive restart is never enabled)
+const uint32_t MAX_SUBMESH_VERTICES = 65536;
+
+// Cluster of at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles, stored as a contiguous run
+// of its sub-mesh's indices so the regular index buffer still draws the whole mesh. Bounds are in mesh space.
+// Layout matches the Meshlet struct in cull.comp (std430).
+struct Meshlet {
+    float       center[3];
+    float       radius;
+    float       coneAxis[3];
+    float       coneCutoff;     // Back-facing from everywhere outside the sphere within this angle, 1 disables the test
+    uint32_t    firstIndex;
+    uint32_t    indexCount;
+    int32_t     vertexOffset;
+    uint32_t    reserved;
+};
+
+const uint32_t MESHLET_MAX_VERTICES     = 64;
+const uint32_t MESHLET_MAX_TRIANGLES    = 124;
+
+// One detail level, all LODs index the shared vertex buffer and own consecutive sub-meshes and meshlets
+struct MeshLod {
+    uint32_t    firstIndex;
+    uint32_t    indexCount;
+    uint32_t    firstSubMesh;
+    uint32_t    subMeshCount;
+    uint32_t    firstMeshlet;
+    uint32_t    meshletCount;
+    float       error;          // Largest geometric deviation from LOD 0 in mesh units
+    uint32_t    reserved;
+};
+
+const uint32_t MAX_LOD_COUNT = 6;
+
+// Everything the cook step produces for one model, serialized by buildMeshCache
+struct MeshData {
+    std::vector<Vertex>     vertices;
+    std::vector<uint32_t>   indices;
+    std::vector<MeshLod>    lods;
+    std::vector<SubMesh>    subMeshes;
+    std::vector<Meshlet>    meshlets;
+};
+
+// Post-transform cache efficiency of an index buffer, simulated with a FIFO cache
+// ACMR: transformed vertices per triangle (3.0 worst case, ~0.5 ideal for regular meshes)
+// ATVR: transformed vertices per unique vertex (1.0 ideal)
+struct VertexCacheStats {
+    uint32_t    vertexCount;
+    uint32_t    triangleCount;
+    uint32_t    transformedVertices;
+    float       acmr;
+    float       atvr;
+};
+
+// Runs the full processing stage below and logs the before/after cache statistics
+void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Mesh Processing
+// Merges bit-identical vertices and rewrites indices to reference the survivors, returns the new vertex count
+size_t weldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+// Reorders triangles for post-transform cache reuse (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation")
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+// Reorders vertices into first-use order of the index buffer so vertex fetch walks memory linearly
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+// Splits every LOD into consecutive triangle runs that each reference at most maxVertices vertices and
+// rewrites indices relative to each run's vertexOffset. Meshes that already fit get one sub-mesh per LOD and stay
+// untouched, otherwise vertices are regrouped per sub-mesh (first-use order is kept, shared ones are duplicated).
+// Fills in the sub-mesh range of every LOD.
+std::vector<SubMesh> splitSubMeshes(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods,
+                                    uint32_t maxVertices = MAX_SUBMESH_VERTICES);
+// Greedily groups consecutive triangles of each sub-mesh into meshlets, the optimized triangle order keeps them compact.
+// Fills in the meshlet range of every LOD.
+std::vector<Meshlet> buildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<SubMesh>& subMeshes,
+                                   std::vector<MeshLod>& lods);
+
+// Mesh Simplification (MeshSimplify.cpp)
+// Quadric edge collapse (Garland & Heckbert, "Surface Simplification Using Quadric Error Metrics"). Vertices collapse onto
+// existing ones so the result indexes the same vertex buffer, border and attribute seam vertices never move. Stops at
+// targetIndexCount or before a collapse would exceed targetError (mesh units), resultError receives the largest error.
+std::vector<uint32_t> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount,
+                                   float targetError, float* resultError = nullptr);
+// Treats indices as LOD 0 and appends up to maxLodCount - 1 coarser levels, halving the triangle count per level
+std::vector<MeshLod> buildLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t maxLodCount = MAX_LOD_COUNT);
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = 16);
@@ -0,0 +1,341 @@
+#include "MeshCache.h"
+#include "ObjLoader.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <algorithm>
+
+#ifdef WIN32
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+    #ifdef WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            CloseHandle(file);
+            return false;
+        }
+        fileHandle = file;
+        fileSize = static_cast<size_t>(size.QuadPart);
+        if (fileSize > 0) {
+            mapHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            mapping = mapHandle ? MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (mapping == nullptr) {
+                close();
+                return false;
+            }
+        }
+    #else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        fileSize = static_cast<size_t>(info.st_size);
+        if (fileSize > 0) {
+            mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                mapping = nullptr;
+                ::close(fd);
+                return false;
+            }
+            // Everything is read front to back exactly once
+            madvise(mapping, fileSize, MADV_SEQUENTIAL);
+        }
+        // The mapping keeps the file alive
+        ::close(fd);
+    #endif
+
+    opened = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+    #ifdef WIN32
+        if (mapping)    UnmapViewOfFile(mapping);
+        if (mapHandle)  CloseHandle(mapHandle);
+        if (fileHandle) CloseHandle(fileHandle);
+        mapHandle   = nullptr;
+        fileHandle  = nullptr;
+    #else
+        if (mapping)    munmap(mapping, fileSize);
+    #endif
+    mapping     = nullptr;
+    fileSize    = 0;
+    opened      = false;
+}
+
+static inline uint64_t rotl64(uint64_t value, int shift)
+{
+    return (value << shift) | (value >> (64 - shift));
+}
+
+uint64_t hashBytes(const void* data, size_t size)
+{
+    // Four independent multiply-rotate lanes over 32-byte stripes keep the hash near memory bandwidth
+    const uint64_t prime1 = 0x9E3779B185EBCA87ull;
+    const uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+    const char* bytes = static_cast<const char*>(data);
+
+    uint64_t lanes[4] = { prime1 + prime2, prime2, 0, 0 - prime1 };
+    size_t offset = 0;
+    for (; offset + 32 <= size; offset += 32) {
+        for (int i = 0; i < 4; i++) {
+            uint64_t word;
+            memcpy(&word, bytes + offset + i * 8, 8);
+            lanes[i] = rotl64(lanes[i] + word * prime2, 31) * prime1;
+        }
+    }
+
+    uint64_t hash = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18);
+    hash += static_cast<uint64_t>(size);
+    for (; offset < size; offset++) {
+        hash = rotl64(hash ^ (static_cast<uint8_t>(bytes[offset]) * prime1), 11) * prime2;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime1;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+std::string meshCachePath(const std::string& sourcePath)
+{
+    return std::filesystem::path(sourcePath).replace_extension(".smesh").string();
+}
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+std::vector<char> buildMeshCache(uint64_t sourceHash, const MeshData& meshData)
+{
+    const std::vector<Vertex>& vertices = meshData.vertices;
+    const std::vector<uint32_t>& indices = meshData.indices;
+    const std::vector<SubMesh>& subMeshes = meshData.subMeshes;
+    const std::vector<Meshlet>& meshlets = meshData.meshlets;
+    const std::vector<MeshLod>& lods = meshData.lods;
+
+    MeshCacheHeader header{};
+    header.magic        = MESH_CACHE_MAGIC;
+    header.version      = MESH_CACHE_VERSION;
+    header.sourceHash   = sourceHash;
+
+    MeshBounds bounds = computeBounds(vertices.data(), vertices.size());
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = bounds.min[i];
+        header.boundsMax[i] = bounds.max[i];
+    }
+
+    // Halve the index buffer whenever every sub-mesh is addressable with 16 bits
+    bool shortIndices = std::all_of(subMeshes.begin(), subMeshes.end(), [](const SubMesh& subMesh) {
+        return subMesh.vertexCount <= MAX_SUBMESH_VERTICES;
+    });
+    std::vector<uint16_t> shortIndexData;
+    if (shortIndices) {
+        shortIndexData.assign(indices.begin(), indices.end());
+    }
+    uint32_t indexStride = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    const void* blobs[MESH_SECTION_COUNT] = {
+        vertices.data(),
+        shortIndices ? static_cast<const void*>(shortIndexData.data()) : static_cast<const void*>(indices.data()),
+        subMeshes.data(),
+        meshlets.data(),
+        lods.data()
+    };
+    MeshCacheSection& vertexSection = header.sections[MESH_SECTION_VERTICES];
+    vertexSection.stride    = sizeof(Vertex);
+    vertexSection.count     = vertices.size();
+    vertexSection.size      = vertices.size() * sizeof(Vertex);
+    MeshCacheSection& indexSection = header.sections[MESH_SECTION_INDICES];
+    indexSection.stride     = indexStride;
+    indexSection.count      = indices.size();
+    indexSection.size       = indices.size() * indexStride;
+    MeshCacheSection& subMeshSection = header.sections[MESH_SECTION_SUBMESHES];
+    subMeshSection.stride   = sizeof(SubMesh);
+    subMeshSection.count    = subMeshes.size();
+    subMeshSection.size     = subMeshes.size() * sizeof(SubMesh);
+    MeshCacheSection& meshletSection = header.sections[MESH_SECTION_MESHLETS];
+    meshletSection.stride   = sizeof(Meshlet);
+    meshletSection.count    = meshlets.size();
+    meshletSection.size     = meshlets.size() * sizeof(Meshlet);
+    MeshCacheSection& lodSection = header.sections[MESH_SECTION_LODS];
+    lodSection.stride       = sizeof(MeshLod);
+    lodSection.count        = lods.size();
+    lodSection.size         = lods.size() * sizeof(MeshLod);
+
+    uint64_t offset = alignUp(sizeof(MeshCacheHeader), MESH_CACHE_ALIGNMENT);
+    for (uint32_t i = 0; i < MESH_SECTION_COUNT; i++) {
+        header.sections[i].offset = offset;
+        offset = alignUp(offset + header.sections[i].size, MESH_CACHE_ALIGNMENT);
+    }
+
+    std::vector<char> image(offset, 0);
+    memcpy(image.data(), &header, sizeof(header));
+    for (uint32_t i = 0; i < MESH_SECTION_COUNT; i++) {
+        if (header.sections[i].size > 0) {
+            memcpy(image.data() + header.sections[i].offset, blobs[i], header.sections[i].size);
+        }
+    }
+    return image;
+}
+
+std::vector<char> cookMesh(const std::string& sourcePath, uint64_t sourceHash)
+{
+    MeshData meshData;
+    loadObj(sourcePath.c_str(), meshData.vertices, meshData.indices);
+    optimizeMesh(meshData.vertices, meshData.indices);
+    meshData.lods = buildLods(meshData.vertices, meshData.indices);
+    meshData.subMeshes = splitSubMeshes(meshData.vertices, meshData.indices, meshData.lods);
+    meshData.meshlets = buildMeshlets(meshData.vertices, meshData.indices, meshData.subMeshes, meshData.lods);
+    return buildMeshCache(sourceHash, meshData);
+}
+
+bool writeMeshCache(const std::string& path, const std::vector<char>& image)
+{
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        file.write(image.data(), static_cast<std::streamsize>(image.size()));
+    }
+
+    std::error_code error;
+    if (std::filesystem::file_size(temporaryPath, error) != image.size()) {
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
+
+bool MeshCache::validate(const char* data, size_t size, std::optional<uint64_t> expectedSourceHash)
+{
+    if (size < sizeof(MeshCacheHeader)) {
+        return false;
+    }
+    const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(data);
+    if (header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION) {
+        return false;
+    }
+    if (expectedSourceHash.has_value() && header->sourceHash != expectedSourceHash.value()) {
+        return false;
+    }
+    uint32_t indexStride = header->sections[MESH_SECTION_INDICES].stride;
+    if (header->sections[MESH_SECTION_VERTICES].stride != sizeof(Vertex) ||
+        (indexStride != sizeof(uint16_t) && indexStride != sizeof(uint32_t)) ||
+        header->sections[MESH_SECTION_SUBMESHES].stride != sizeof(SubMesh) ||
+        header->sections[MESH_SECTION_MESHLETS].stride != sizeof(Meshlet) ||
+        header->sections[MESH_SECTION_LODS].stride != sizeof(MeshLod) ||
+        header->sections[MESH_SECTION_LODS].count == 0) {
+        return false;
+    }
+    for (uint32_t i = 0; i < MESH_SECTION_COUNT; i++) {
+        const MeshCacheSection& section = header->sections[i];
+        if (section.offset % MESH_CACHE_ALIGNMENT != 0 || section.offset > size || section.size > size - section.offset ||
+            section.size != section.count * section.stride) {
+            return false;
+        }
+    }
+
+    // Sub-mesh, meshlet and LOD ranges are used directly as draw parameters
+    const SubMesh* subMeshes = reinterpret_cast<const SubMesh*>(data + header->sections[MESH_SECTION_SUBMESHES].offset);
+    uint64_t vertexCount = header->sections[MESH_SECTION_VERTICES].count;
+    uint64_t indexCount = header->sections[MESH_SECTION_INDICES].count;
+    for (uint64_t i = 0; i < header->sections[MESH_SECTION_SUBMESHES].count; i++) {
+        const SubMesh& subMesh = subMeshes[i];
+        if (subMesh.vertexOffset < 0 || uint64_t(subMesh.vertexOffset) + subMesh.vertexCount > vertexCount ||
+            uint64_t(subMesh.firstIndex) + subMesh.indexCount > indexCount) {
+            return false;
+        }
+    }
+    const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(data + header->sections[MESH_SECTION_MESHLETS].offset);
+    for (uint64_t i = 0; i < header->sections[MESH_SECTION_MESHLETS].count; i++) {
+        const Meshlet& meshlet = meshlets[i];
+        if (meshlet.vertexOffset < 0 || uint64_t(meshlet.vertexOffset) >= vertexCount ||
+            uint64_t(meshlet.firstIndex) + meshlet.indexCount > indexCount) {
+            return false;
+        }
+    }
+    const MeshLod* lods = reinterpret_cast<const MeshLod*>(data + header->sections[MESH_SECTION_LODS].offset);
+    for (uint64_t i = 0; i < header->sections[MESH_SECTION_LODS].count; i++) {
+        const MeshLod& lod = lods[i];
+        if (uint64_t(lod.firstIndex) + lod.indexCount > indexCount ||
+            uint64_t(lod.firstSubMesh) + lod.subMeshCount > header->sections[MESH_SECTION_SUBMESHES].count ||
+            uint64_t(lod.firstMeshlet) + lod.meshletCount > header->sections[MESH_SECTION_MESHLETS].count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MeshCache::open(const std::string& path, std::optional<uint64_t> expectedSourceHash)
+{
+    release();
+    if (!file.open(path)) {
+        return false;
+    }
+    if (!validate(file.data(), file.size(), expectedSourceHash)) {
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+void MeshCache::adopt(std::vector<char>&& image)
+{
+    release();
+    memory = std::move(image);
+}
+
+MeshBounds MeshCache::bounds() const
+{
+    const MeshCacheHeader& cacheHeader = header();
+    MeshBounds bounds;
+    bounds.min = glm::vec3(cacheHeader.boundsMin[0], cacheHeader.boundsMin[1], cacheHeader.boundsMin[2]);
+    bounds.max = glm::vec3(cacheHeader.boundsMax[0], cacheHeader.boundsMax[1], cacheHeader.boundsMax[2]);
+    return bounds;
+}
+
+void MeshCache::release()
+{
+    file.close();
+    memory.clear();
+    memory.shrink_to_fit();
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <string>
+#include <optional>
+#include <vector>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return opened; }
+
+    const char* data() const { return static_cast<const char*>(mapping); }
+    size_t      size() const { return fileSize; }
+
+private:
+    void*       mapping     = nullptr;
+    size_t      fileSize    = 0;
+    bool        opened      = false;
+    #ifdef WIN32
+        void*   fileHandle  = nullptr;
+        void*   mapHandle   = nullptr;
+    #endif
+};
+
+// Cooked mesh file (.smesh): a header followed by GPU-ready blobs, each aligned to MESH_CACHE_ALIGNMENT
+// so they can be memcpy'd from the mapping straight into a staging buffer.
+// Bump MESH_CACHE_VERSION whenever the header, a section layout or the mesh processing changes.
+const uint32_t MESH_CACHE_MAGIC     = 0x48534D53; // "SMSH"
+const uint32_t MESH_CACHE_VERSION   = 6;
+const uint32_t MESH_CACHE_ALIGNMENT = 256;
+
+enum MeshSection : uint32_t {
+    MESH_SECTION_VERTICES = 0,
+    MESH_SECTION_INDICES,       // uint16_t when every sub-mesh fits MAX_SUBMESH_VERTICES, uint32_t otherwise
+    MESH_SECTION_SUBMESHES,
+    MESH_SECTION_MESHLETS,
+    MESH_SECTION_LODS,
+    MESH_SECTION_COUNT
+};
+
+struct MeshCacheSection {
+    uint64_t    offset;
+    uint64_t    size;
+    uint64_t    count;
+    uint32_t    stride;
+    uint32_t    reserved;
+};
+
+struct MeshCacheHeader {
+    uint32_t            magic;
+    uint32_t            version;
+    uint64_t            sourceHash;
+    // Position AABB of the vertex section, used to quantize packed vertex formats at load time
+    float               boundsMin[3];
+    float               boundsMax[3];
+    MeshCacheSection    sections[MESH_SECTION_COUNT];
+};
+
+// Non-cryptographic 64-bit hash used to key caches on their source file contents
+uint64_t hashBytes(const void* data, size_t size);
+std::string meshCachePath(const std::string& sourcePath);
+
+// Serializes a processed mesh into the .smesh layout, indices are relative to their sub-mesh (see splitSubMeshes)
+std::vector<char> buildMeshCache(uint64_t sourceHash, const MeshData& meshData);
+// Full cook pipeline shared by loadModel and swiftcanon-cook: parse, optimize, build LODs, split and build meshlets
+std::vector<char> cookMesh(const std::string& sourcePath, uint64_t sourceHash);
+// Writes to a temporary file and renames it over path, so readers never see a partial cache
+bool writeMeshCache(const std::string& path, const std::vector<char>& image);
+
+class MeshCache
+{
+public:
+    // Maps a cooked mesh, fails if the file is missing, from another version or cooked from a different source
+    bool open(const std::string& path, std::optional<uint64_t> expectedSourceHash);
+    // Takes ownership of an in-memory image when the cache could not be written to disk
+    void adopt(std::vector<char>&& image);
+    void release();
+
+    const MeshCacheHeader&  header() const { return *reinterpret_cast<const MeshCacheHeader*>(base()); }
+    const void*             sectionData(MeshSection section) const { return base() + header().sections[section].offset; }
+    uint64_t                sectionSize(MeshSection section) const { return header().sections[section].size; }
+    uint64_t                sectionCount(MeshSection section) const { return header().sections[section].count; }
+    uint32_t                indexStride() const { return header().sections[MESH_SECTION_INDICES].stride; }
+    const SubMesh*          subMeshes() const { return static_cast<const SubMesh*>(sectionData(MESH_SECTION_SUBMESHES)); }
+    const Meshlet*          meshlets() const { return static_cast<const Meshlet*>(sectionData(MESH_SECTION_MESHLETS)); }
+    const MeshLod*          lods() const { return static_cast<const MeshLod*>(sectionData(MESH_SECTION_LODS)); }
+    MeshBounds              bounds() const;
+
+private:
+    const char* base() const { return file.isOpen() ? file.data() : memory.data(); }
+    static bool validate(const char* data, size_t size, std::optional<uint64_t> expectedSourceHash);
+
+    MappedFile          file;
+    std::vector<char>   memory;
+};
@@ -0,0 +1,299 @@
+#include "Mesh.h"
+
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+// Symmetric 4x4 error quadric, stored as the upper triangle of A, the vector b and the constant c, plus the
+// accumulated plane weight so errors can be normalized back into squared mesh units
+struct Quadric {
+    double  a00 = 0.0, a11 = 0.0, a22 = 0.0;
+    double  a10 = 0.0, a20 = 0.0, a21 = 0.0;
+    double  b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double  c = 0.0;
+    double  weight = 0.0;
+
+    void addPlane(const glm::vec3& normal, float distance, float planeWeight) {
+        double x = normal.x, y = normal.y, z = normal.z, d = distance, w = planeWeight;
+        a00 += w * x * x;   a11 += w * y * y;   a22 += w * z * z;
+        a10 += w * y * x;   a20 += w * z * x;   a21 += w * z * y;
+        b0  += w * x * d;   b1  += w * y * d;   b2  += w * z * d;
+        c   += w * d * d;
+        weight += w;
+    }
+
+    void add(const Quadric& other) {
+        a00 += other.a00;   a11 += other.a11;   a22 += other.a22;
+        a10 += other.a10;   a20 += other.a20;   a21 += other.a21;
+        b0  += other.b0;    b1  += other.b1;    b2  += other.b2;
+        c   += other.c;
+        weight += other.weight;
+    }
+
+    // Weighted mean squared distance of p to the accumulated planes
+    double error(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double rx = a00 * x + a10 * y + a20 * z;
+        double ry = a10 * x + a11 * y + a21 * z;
+        double rz = a20 * x + a21 * y + a22 * z;
+        double e = rx * x + ry * y + rz * z + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+    }
+};
+
+struct Collapse {
+    uint32_t    source;
+    uint32_t    target;
+    double      cost;
+};
+
+static inline uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+    return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+static inline glm::vec3 triangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    return glm::cross(b - a, c - a);
+}
+
+// Vertices on open borders, or sharing their position with another vertex (attribute seams), must not move
+static std::vector<bool> findLockedVertices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+    std::vector<bool> locked(vertices.size(), false);
+
+    struct PositionHash {
+        size_t operator()(const glm::vec3& p) const {
+            uint32_t bits[3];
+            float components[3] = { p.x + 0.0f, p.y + 0.0f, p.z + 0.0f };
+            memcpy(bits, components, sizeof(bits));
+            return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        }
+    };
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> firstAtPosition;
+    firstAtPosition.reserve(vertices.size());
+    for (uint32_t i = 0; i < vertices.size(); i++) {
+        auto [it, inserted] = firstAtPosition.try_emplace(vertices[i].pos, i);
+        if (!inserted) {
+            locked[i] = true;
+            locked[it->second] = true;
+        }
+    }
+
+    // A directed edge without its twin is a border edge
+    std::unordered_set<uint64_t> directedEdges;
+    directedEdges.reserve(indices.size());
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            directedEdges.insert(edgeKey(indices[i + k], indices[i + (k + 1) % 3]));
+        }
+    }
+    for (uint64_t edge : directedEdges) {
+        uint32_t a = static_cast<uint32_t>(edge >> 32);
+        uint32_t b = static_cast<uint32_t>(edge);
+        if (directedEdges.count(edgeKey(b, a)) == 0) {
+            locked[a] = true;
+            locked[b] = true;
+        }
+    }
+    return locked;
+}
+
+std::vector<uint32_t> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount,
+                                   float targetError, float* resultError)
+{
+    const size_t vertexCount = vertices.size();
+    std::vector<uint32_t> result = indices;
+    std::vector<bool> locked = findLockedVertices(vertices, indices);
+
+    // Area weighted plane quadrics of the source triangles
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        const glm::vec3& a = vertices[indices[i + 0]].pos;
+        const glm::vec3& b = vertices[indices[i + 1]].pos;
+        const glm::vec3& c = vertices[indices[i + 2]].pos;
+        glm::vec3 normal = triangleNormal(a, b, c);
+        float doubleArea = glm::length(normal);
+        if (doubleArea == 0.0f) {
+            continue;
+        }
+        normal /= doubleArea;
+        for (int k = 0; k < 3; k++) {
+            quadrics[indices[i + k]].addPlane(normal, -glm::dot(normal, a), doubleArea * 0.5f);
+        }
+    }
+
+    const double maxCost = static_cast<double>(targetError) * targetError;
+    double largestCost = 0.0;
+
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+    std::vector<uint32_t> vertexTriangles;
+    std::vector<uint32_t> collapseTarget(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<uint64_t> edges;
+    std::vector<Collapse> collapses;
+
+    while (result.size() > targetIndexCount) {
+        size_t triangleCount = result.size() / 3;
+
+        // Vertex to triangle adjacency of the current mesh
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (uint32_t index : result) {
+            triangleOffsets[index + 1]++;
+        }
+        for (size_t i = 0; i < vertexCount; i++) {
+            triangleOffsets[i + 1] += triangleOffsets[i];
+        }
+        vertexTriangles.resize(result.size());
+        std::vector<uint32_t> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++) {
+            vertexTriangles[cursor[result[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        // Cheapest direction of every unique edge
+        edges.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+                if (!(locked[a] && locked[b])) {
+                    edges.push_back(edgeKey(std::min(a, b), std::max(a, b)));
+                }
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        collapses.clear();
+        for (uint64_t edge : edges) {
+            uint32_t a = static_cast<uint32_t>(edge >> 32);
+            uint32_t b = static_cast<uint32_t>(edge);
+            Quadric merged = quadrics[a];
+            merged.add(quadrics[b]);
+            double costAB = locked[a] ? INFINITY : merged.error(vertices[b].pos);
+            double costBA = locked[b] ? INFINITY : merged.error(vertices[a].pos);
+            Collapse collapse = costAB <= costBA ? Collapse{ a, b, costAB } : Collapse{ b, a, costBA };
+            if (collapse.cost <= maxCost) {
+                collapses.push_back(collapse);
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) {
+            return lhs.cost < rhs.cost;
+        });
+
+        // Apply the cheapest independent collapses, every collapse removes about two triangles
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            collapseTarget[i] = i;
+        }
+        std::fill(touched.begin(), touched.end(), false);
+        size_t trianglesToRemove = triangleCount - targetIndexCount / 3;
+        size_t trianglesRemoved = 0;
+        size_t collapseCount = 0;
+
+        for (const Collapse& collapse : collapses) {
+            if (trianglesRemoved >= trianglesToRemove) {
+                break;
+            }
+            uint32_t source = collapse.source, target = collapse.target;
+            if (touched[source] || touched[target]) {
+                continue;
+            }
+
+            // Reject collapses that flip or degenerate a surviving triangle around the source
+            bool flips = false;
+            uint32_t sharedTriangles = 0;
+            const glm::vec3& targetPosition = vertices[target].pos;
+            for (uint32_t t = triangleOffsets[source]; t < triangleOffsets[source + 1] && !flips; t++) {
+                const uint32_t* corners = &result[vertexTriangles[t] * 3];
+                if (corners[0] == target || corners[1] == target || corners[2] == target) {
+                    sharedTriangles++;
+                    continue;
+                }
+                glm::vec3 before[3], after[3];
+                for (int k = 0; k < 3; k++) {
+                    before[k] = vertices[corners[k]].pos;
+                    after[k] = corners[k] == source ? targetPosition : before[k];
+                }
+                glm::vec3 normalBefore = triangleNormal(before[0], before[1], before[2]);
+                glm::vec3 normalAfter = triangleNormal(after[0], after[1], after[2]);
+                flips = glm::dot(normalBefore, normalAfter) <= 0.0f;
+            }
+            if (flips) {
+                continue;
+            }
+
+            // Lock the source's one-ring so the flip test above stays valid for the rest of the pass
+            for (uint32_t t = triangleOffsets[source]; t < triangleOffsets[source + 1]; t++) {
+                const uint32_t* corners = &result[vertexTriangles[t] * 3];
+                touched[corners[0]] = touched[corners[1]] = touched[corners[2]] = true;
+            }
+            collapseTarget[source] = target;
+            quadrics[target].add(quadrics[source]);
+            largestCost = std::max(largestCost, collapse.cost);
+            trianglesRemoved += sharedTriangles;
+            collapseCount++;
+        }
+
+        if (collapseCount == 0) {
+            break;
+        }
+
+        // Remap and drop the triangles that became degenerate
+        size_t writeOffset = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            uint32_t a = collapseTarget[result[i + 0]];
+            uint32_t b = collapseTarget[result[i + 1]];
+            uint32_t c = collapseTarget[result[i + 2]];
+            if (a != b && b != c && a != c) {
+                result[writeOffset++] = a;
+                result[writeOffset++] = b;
+                result[writeOffset++] = c;
+            }
+        }
+        result.resize(writeOffset);
+    }
+
+    if (resultError) {
+        *resultError = static_cast<float>(std::sqrt(largestCost));
+    }
+    return result;
+}
+
+std::vector<MeshLod> buildLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t maxLodCount)
+{
+    std::vector<MeshLod> lods;
+    lods.push_back(MeshLod{ 0, static_cast<uint32_t>(indices.size()), 0, 0, 0, 0, 0.0f, 0 });
+    const std::vector<uint32_t> baseIndices = indices;
+
+    // Never deviate by more than a few percent of the mesh size, even for the coarsest level
+    MeshBounds bounds = computeBounds(vertices.data(), vertices.size());
+    float maxError = glm::length(bounds.max - bounds.min) * 0.05f;
+
+    for (uint32_t level = 1; level < maxLodCount; level++) {
+        const MeshLod& previous = lods.back();
+        size_t targetIndexCount = (baseIndices.size() >> level) / 3 * 3;
+        float error = 0.0f;
+        std::vector<uint32_t> lodIndices = simplifyMesh(vertices, baseIndices, targetIndexCount, maxError, &error);
+
+        // Stop once the error bound keeps the simplifier from making meaningful progress
+        if (lodIndices.empty() || lodIndices.size() > previous.indexCount * 9 / 10) {
+            break;
+        }
+        optimizeVertexCache(lodIndices, vertices.size());
+
+        MeshLod lod{};
+        lod.firstIndex  = static_cast<uint32_t>(indices.size());
+        lod.indexCount  = static_cast<uint32_t>(lodIndices.size());
+        lod.error       = std::max(error, previous.error);
+        indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+        lods.push_back(lod);
+    }
+
+    std::cout << "[MESH] Built " << lods.size() << " LODs:" << std::endl;
+    for (size_t i = 0; i < lods.size(); i++) {
+        std::cout << "[MESH]   LOD " << i << ": " << lods[i].indexCount / 3 << " triangles, error " << lods[i].error << std::endl;
+    }
+    return lods;
+}
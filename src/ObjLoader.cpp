@@ -0,0 +1,344 @@
+#include "ObjLoader.h"
+#include "MeshCache.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <string>
+#include <cstring>
+#include <cmath>
+
+// Chunks smaller than this are not worth a thread
+static const size_t kMinChunkSize = 256 * 1024;
+static const uint32_t kNoNormal = UINT32_MAX;
+
+struct ObjCorner {
+    uint32_t    position;
+    uint32_t    normal;
+};
+
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+
+    // Counting pass
+    size_t      positionCount   = 0;
+    size_t      normalCount     = 0;
+    size_t      triangleCount   = 0;
+
+    // Prefix sums of the counts of all preceding chunks
+    size_t      positionBase    = 0;
+    size_t      normalBase      = 0;
+    size_t      triangleBase    = 0;
+
+    std::string error;
+};
+
+template <typename Function>
+static void runChunks(std::vector<ObjChunk>& chunks, Function function)
+{
+    std::vector<std::thread> workers;
+    workers.reserve(chunks.size() - 1);
+    for (size_t i = 1; i < chunks.size(); i++) {
+        workers.emplace_back(function, std::ref(chunks[i]));
+    }
+    function(chunks[0]);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+static inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* skipBlanks(const char* p, const char* end)
+{
+    while (p < end && isBlank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static inline const char* nextLine(const char* p, const char* end)
+{
+    const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+    return newline ? newline + 1 : end;
+}
+
+static inline const char* lineEnd(const char* p, const char* end)
+{
+    const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+    return newline ? newline : end;
+}
+
+// Locale independent float parser, about an order of magnitude faster than strtof on OBJ data
+static const char* parseFloat(const char* p, const char* end, float& value)
+{
+    static const double powersOf10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    p = skipBlanks(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        }
+        else {
+            exponent++;
+        }
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negativeExponent = *p == '-';
+            p++;
+        }
+        int explicitExponent = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            explicitExponent = std::min(explicitExponent * 10 + (*p - '0'), 10000);
+            p++;
+        }
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+
+    double result = static_cast<double>(mantissa);
+    if (exponent >= -22 && exponent <= 22) {
+        result = exponent < 0 ? result / powersOf10[-exponent] : result * powersOf10[exponent];
+    }
+    else {
+        result *= std::pow(10.0, exponent);
+    }
+    value = static_cast<float>(negative ? -result : result);
+    return p;
+}
+
+static inline const char* parseInt(const char* p, const char* end, int64_t& value)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    int64_t result = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        result = result * 10 + (*p - '0');
+        p++;
+    }
+    value = negative ? -result : result;
+    return p;
+}
+
+// OBJ indices are 1-based, negative ones are relative to the elements defined so far
+static inline bool resolveIndex(int64_t index, size_t definedSoFar, size_t total, uint32_t& resolved)
+{
+    int64_t absolute = index > 0 ? index - 1 : static_cast<int64_t>(definedSoFar) + index;
+    if (index == 0 || absolute < 0 || absolute >= static_cast<int64_t>(total)) {
+        return false;
+    }
+    resolved = static_cast<uint32_t>(absolute);
+    return true;
+}
+
+static void countChunk(ObjChunk& chunk)
+{
+    for (const char* p = chunk.begin; p < chunk.end; p = nextLine(p, chunk.end)) {
+        p = skipBlanks(p, chunk.end);
+        if (p + 1 >= chunk.end) {
+            continue;
+        }
+        if (p[0] == 'v' && isBlank(p[1])) {
+            chunk.positionCount++;
+        }
+        else if (p[0] == 'v' && p[1] == 'n') {
+            chunk.normalCount++;
+        }
+        else if (p[0] == 'f' && isBlank(p[1])) {
+            const char* end = lineEnd(p, chunk.end);
+            size_t cornerCount = 0;
+            for (const char* q = p + 1; q < end;) {
+                q = skipBlanks(q, end);
+                if (q < end) {
+                    cornerCount++;
+                    while (q < end && !isBlank(*q)) {
+                        q++;
+                    }
+                }
+            }
+            if (cornerCount >= 3) {
+                chunk.triangleCount += cornerCount - 2;
+            }
+        }
+    }
+}
+
+static void parseChunk(ObjChunk& chunk, std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals, std::vector<ObjCorner>& corners)
+{
+    size_t positionCursor = chunk.positionBase;
+    size_t normalCursor = chunk.normalBase;
+    size_t cornerCursor = chunk.triangleBase * 3;
+
+    for (const char* p = chunk.begin; p < chunk.end; p = nextLine(p, chunk.end)) {
+        p = skipBlanks(p, chunk.end);
+        if (p + 1 >= chunk.end) {
+            continue;
+        }
+        const char* end = lineEnd(p, chunk.end);
+
+        if (p[0] == 'v' && isBlank(p[1])) {
+            glm::vec3& position = positions[positionCursor++];
+            const char* q = parseFloat(p + 1, end, position.x);
+            q = parseFloat(q, end, position.y);
+            parseFloat(q, end, position.z);
+        }
+        else if (p[0] == 'v' && p[1] == 'n') {
+            glm::vec3& normal = normals[normalCursor++];
+            const char* q = parseFloat(p + 2, end, normal.x);
+            q = parseFloat(q, end, normal.y);
+            parseFloat(q, end, normal.z);
+        }
+        else if (p[0] == 'f' && isBlank(p[1])) {
+            ObjCorner first{}, previous{};
+            uint32_t cornerCount = 0;
+            for (const char* q = skipBlanks(p + 1, end); q < end; q = skipBlanks(q, end)) {
+                int64_t positionIndex = 0, texcoordIndex = 0, normalIndex = 0;
+                q = parseInt(q, end, positionIndex);
+                if (q < end && *q == '/') {
+                    q++;
+                    if (q < end && *q != '/') {
+                        q = parseInt(q, end, texcoordIndex);
+                    }
+                    if (q < end && *q == '/') {
+                        q = parseInt(q + 1, end, normalIndex);
+                    }
+                }
+                while (q < end && !isBlank(*q)) {
+                    q++;
+                }
+
+                ObjCorner corner{};
+                if (!resolveIndex(positionIndex, positionCursor, positions.size(), corner.position)) {
+                    chunk.error = "[OBJ] Invalid vertex index in face: " + std::string(p, end);
+                    return;
+                }
+                corner.normal = kNoNormal;
+                if (normalIndex != 0 && !resolveIndex(normalIndex, normalCursor, normals.size(), corner.normal)) {
+                    chunk.error = "[OBJ] Invalid normal index in face: " + std::string(p, end);
+                    return;
+                }
+
+                // Fan triangulation, same as tinyobj's default for convex polygons
+                if (cornerCount == 0) {
+                    first = corner;
+                }
+                else if (cornerCount >= 2) {
+                    corners[cornerCursor++] = first;
+                    corners[cornerCursor++] = previous;
+                    corners[cornerCursor++] = corner;
+                }
+                previous = corner;
+                cornerCount++;
+            }
+        }
+    }
+}
+
+void loadObj(const char* path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t threadCount)
+{
+    MappedFile file;
+    if (!file.open(path)) {
+        throw std::runtime_error("[OBJ] Failed to open file: " + std::string(path));
+    }
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t chunkCount = std::clamp<size_t>(file.size() / kMinChunkSize, 1, threadCount);
+
+    // Split at line boundaries
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* chunkBegin = begin;
+    for (size_t i = 0; i < chunkCount; i++) {
+        const char* chunkEnd = end;
+        if (i + 1 < chunkCount) {
+            chunkEnd = std::max(chunkBegin, begin + file.size() * (i + 1) / chunkCount);
+            chunkEnd = chunkEnd < end ? nextLine(chunkEnd, end) : end;
+        }
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    runChunks(chunks, countChunk);
+
+    size_t positionCount = 0, normalCount = 0, triangleCount = 0;
+    for (ObjChunk& chunk : chunks) {
+        chunk.positionBase  = positionCount;
+        chunk.normalBase    = normalCount;
+        chunk.triangleBase  = triangleCount;
+        positionCount       += chunk.positionCount;
+        normalCount         += chunk.normalCount;
+        triangleCount       += chunk.triangleCount;
+    }
+    if (triangleCount * 3 > UINT32_MAX) {
+        throw std::runtime_error("[OBJ] Too many triangles for 32-bit indices: " + std::string(path));
+    }
+
+    std::vector<glm::vec3> positions(positionCount);
+    std::vector<glm::vec3> normals(normalCount);
+    std::vector<ObjCorner> corners(triangleCount * 3);
+    runChunks(chunks, [&](ObjChunk& chunk) {
+        parseChunk(chunk, positions, normals, corners);
+    });
+    for (const ObjChunk& chunk : chunks) {
+        if (!chunk.error.empty()) {
+            throw std::runtime_error(chunk.error);
+        }
+    }
+
+    // Expand corners into vertices, each chunk owns the triangles it parsed
+    size_t vertexBase = vertices.size();
+    vertices.resize(vertexBase + corners.size());
+    indices.resize(vertexBase + corners.size());
+    runChunks(chunks, [&](ObjChunk& chunk) {
+        size_t cornerBegin = chunk.triangleBase * 3;
+        size_t cornerEnd = cornerBegin + chunk.triangleCount * 3;
+        for (size_t i = cornerBegin; i < cornerEnd; i++) {
+            Vertex& vertex = vertices[vertexBase + i];
+            vertex.pos = positions[corners[i].position];
+            vertex.color = corners[i].normal != kNoNormal ? normals[corners[i].normal] : glm::vec3(0.0f);
+            indices[vertexBase + i] = static_cast<uint32_t>(vertexBase + i);
+        }
+    });
+
+    std::cout << "[OBJ] Parsed " << path << " with " << chunkCount << " threads: " << positionCount << " positions, "
+              << normalCount << " normals, " << triangleCount << " triangles" << std::endl;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <vector>
+#include <cstdint>
+
+// Multithreaded OBJ parser
+// The file is memory mapped and split at line boundaries into one chunk per worker. A counting pass sizes
+// every chunk, prefix sums over the counts give each chunk its global offsets, and a parsing pass then
+// writes positions, normals and triangles straight into the final arrays without a merge copy.
+// Supports v, vn and f (v, v/vt, v//vn, v/vt/vn, negative indices, polygons are fan triangulated).
+// Produces one vertex per face corner with an identity index list, like the rest of the cook path expects.
+void loadObj(const char* path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t threadCount = 0);
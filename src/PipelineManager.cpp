@@ -0,0 +1,126 @@
+#include "PipelineManager.h"
+#include "CpuProfiler.h"
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <stdexcept>
+
+void PipelineManager::init(VkDevice device, uint32_t threadCount)
+{
+    this->device = device;
+    stopping = false;
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers.emplace_back(&PipelineManager::workerLoop, this);
+    }
+}
+
+void PipelineManager::destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    for (PipelineEntry& entry : entries) {
+        if (entry.pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, entry.pipeline, nullptr);
+        }
+    }
+    entries.clear();
+}
+
+PipelineHandle PipelineManager::compile(const std::string& name, std::function<VkPipeline()> build)
+{
+    PipelineHandle handle;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        handle = static_cast<PipelineHandle>(entries.size());
+        entries.emplace_back();
+        entries.back().name = name;
+        entries.back().build = std::move(build);
+        queue.push_back(&entries.back());
+    }
+    wake.notify_one();
+    return handle;
+}
+
+VkPipeline PipelineManager::get(PipelineHandle handle) const
+{
+    if (handle == NO_PIPELINE) {
+        return VK_NULL_HANDLE;
+    }
+    const PipelineEntry& entry = entries[handle];
+    checkFailed(entry);
+    return entry.state.load(std::memory_order_acquire) == PIPELINE_READY ? entry.pipeline : VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineManager::wait(PipelineHandle handle)
+{
+    if (handle == NO_PIPELINE) {
+        return VK_NULL_HANDLE;
+    }
+    const PipelineEntry& entry = entries[handle];
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return entry.state.load(std::memory_order_acquire) != PIPELINE_PENDING; });
+    }
+    checkFailed(entry);
+    return entry.pipeline;
+}
+
+void PipelineManager::checkFailed(const PipelineEntry& entry) const
+{
+    if (entry.state.load(std::memory_order_acquire) == PIPELINE_FAILED) {
+        throw std::runtime_error("[PIPELINE] Failed to compile " + entry.name + ": " + entry.error);
+    }
+}
+
+void PipelineManager::workerLoop()
+{
+    CpuProfiler::setThreadName("pipeline compiler");
+    while (true) {
+        PipelineEntry* entry;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            // Queued builds still run when stopping, their pipelines are part of the cache saved on exit
+            if (queue.empty()) {
+                return;
+            }
+            entry = queue.front();
+            queue.pop_front();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        uint32_t state = PIPELINE_READY;
+        try {
+            // Entries live until destroy, so the name outlives the trace written before cleanup
+            CpuProfileScope scope(entry->name.c_str());
+            entry->pipeline = entry->build();
+        }
+        catch (const std::exception& e) {
+            entry->error = e.what();
+            state = PIPELINE_FAILED;
+        }
+        entry->build = nullptr;
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            entry->state.store(state, std::memory_order_release);
+            finishedCount.fetch_add(1, std::memory_order_release);
+        }
+        finished.notify_all();
+
+        // One write per line so messages of concurrent builds don't interleave
+        std::ostringstream message;
+        message << "[PIPELINE] " << (state == PIPELINE_READY ? "Compiled " : "Failed to compile ") << entry->name << " in " << milliseconds << " ms\n";
+        std::cout << message.str() << std::flush;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+// Reference to a pipeline that may still be compiling
+using PipelineHandle = uint32_t;
+const PipelineHandle NO_PIPELINE = UINT32_MAX;
+
+// Background pipeline compilation
+// compile queues a build function and returns at once, worker threads run the builds in submission order. Builds
+// share one VkPipelineCache, which the driver synchronizes internally. get returns VK_NULL_HANDLE until the
+// pipeline is ready, so the caller draws with a fallback or skips the draw instead of waiting for the driver.
+// A build may throw, the error is rethrown on the main thread by the next get or wait of that pipeline.
+class PipelineManager
+{
+public:
+    PipelineManager() = default;
+    PipelineManager(const PipelineManager&) = delete;
+    PipelineManager& operator=(const PipelineManager&) = delete;
+
+    void init(VkDevice device, uint32_t threadCount);
+    // Finishes every queued build, then destroys all pipelines
+    void destroy();
+
+    // Called on the main thread only
+    PipelineHandle compile(const std::string& name, std::function<VkPipeline()> build);
+    VkPipeline get(PipelineHandle handle) const;
+    VkPipeline wait(PipelineHandle handle);
+
+    // Bumped whenever a build finishes, commands recorded against an older value may use a fallback
+    uint32_t readyCount() const { return finishedCount.load(std::memory_order_acquire); }
+
+private:
+    enum PipelineState : uint32_t {
+        PIPELINE_PENDING,
+        PIPELINE_READY,
+        PIPELINE_FAILED
+    };
+
+    struct PipelineEntry {
+        std::string                 name;
+        std::function<VkPipeline()> build;
+        VkPipeline                  pipeline    = VK_NULL_HANDLE;
+        std::string                 error;
+        std::atomic<uint32_t>       state{PIPELINE_PENDING};    // pipeline and error are published with it
+    };
+
+    void workerLoop();
+    void checkFailed(const PipelineEntry& entry) const;
+
+    VkDevice                    device          = VK_NULL_HANDLE;
+    std::vector<std::thread>    workers;
+    std::mutex                  mutex;
+    std::condition_variable     wake;
+    std::condition_variable     finished;
+    // Deque so entries keep their address while the main thread appends
+    std::deque<PipelineEntry>   entries;
+    std::deque<PipelineEntry*>  queue;
+    std::atomic<uint32_t>       finishedCount{0};
+    bool                        stopping        = false;
+};
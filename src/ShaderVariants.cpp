@@ -0,0 +1,45 @@
+#include "ShaderVariants.h"
+
+const char* shadingModeName(ShadingMode mode)
+{
+    switch (mode) {
+        case SHADING_MODE_TINT:     return "tint";
+        case SHADING_MODE_FACETED:  return "faceted";
+        case SHADING_MODE_NORMALS:  return "normals";
+        case SHADING_MODE_OVERDRAW: return "overdraw";
+        default:                    return "unknown";
+    }
+}
+
+bool parseShadingMode(const std::string& name, ShadingMode& mode)
+{
+    for (uint32_t i = 0; i < SHADING_MODE_COUNT; i++) {
+        if (name == shadingModeName(static_cast<ShadingMode>(i))) {
+            mode = static_cast<ShadingMode>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string shaderFeaturesName(ShaderFeatures features)
+{
+    return std::string(vertexFormatName(featureVertexFormat(features))) + ", " + shadingModeName(featureShadingMode(features));
+}
+
+ShaderSpecialization::ShaderSpecialization(ShaderFeatures features)
+{
+    constants[0] = featureVertexFormat(features);
+    constants[1] = featureShadingMode(features);
+
+    for (uint32_t i = 0; i < entries.size(); i++) {
+        entries[i].constantID   = i;
+        entries[i].offset       = i * sizeof(uint32_t);
+        entries[i].size         = sizeof(uint32_t);
+    }
+
+    info.mapEntryCount  = static_cast<uint32_t>(entries.size());
+    info.pMapEntries    = entries.data();
+    info.dataSize       = sizeof(constants);
+    info.pData          = constants.data();
+}
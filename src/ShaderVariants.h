@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <string>
+#include <cstdint>
+
+// Must match SHADING_MODE in shader.frag
+enum ShadingMode : uint32_t {
+    SHADING_MODE_TINT       = 0,    // Mesh space normal times the instance color
+    SHADING_MODE_FACETED    = 1,    // Headlight Lambert on face normals rebuilt from screen-space derivatives
+    SHADING_MODE_NORMALS    = 2,    // Debug view of the mesh space normals
+    SHADING_MODE_OVERDRAW   = 3,    // Heat map of fragments per pixel, additive blending without depth testing
+    SHADING_MODE_COUNT
+};
+
+const char* shadingModeName(ShadingMode mode);
+bool parseShadingMode(const std::string& name, ShadingMode& mode);
+
+// Graphics pipeline variant key
+// Every field is a specialization constant, so each variant is compiled with the other paths stripped and the
+// shaders never branch on it at runtime. New fields take the next free bits and the next constant_id.
+//   bits 0-1   VertexFormat    constant_id 0, shader.vert
+//   bits 2-3   ShadingMode     constant_id 1, shader.frag
+using ShaderFeatures = uint32_t;
+
+inline ShaderFeatures makeShaderFeatures(VertexFormat vertexFormat, ShadingMode shadingMode)
+{
+    return static_cast<uint32_t>(vertexFormat) | (static_cast<uint32_t>(shadingMode) << 2);
+}
+inline VertexFormat featureVertexFormat(ShaderFeatures features) { return static_cast<VertexFormat>(features & 0x3); }
+inline ShadingMode  featureShadingMode(ShaderFeatures features) { return static_cast<ShadingMode>((features >> 2) & 0x3); }
+
+std::string shaderFeaturesName(ShaderFeatures features);
+
+// Specialization constants of one variant, shared by both stages, each stage only picks up the ids it declares
+// Not copyable, info points into the object itself.
+struct ShaderSpecialization {
+    explicit ShaderSpecialization(ShaderFeatures features);
+    ShaderSpecialization(const ShaderSpecialization&) = delete;
+    ShaderSpecialization& operator=(const ShaderSpecialization&) = delete;
+
+    std::array<uint32_t, 2>                 constants;
+    std::array<VkSpecializationMapEntry, 2> entries;
+    VkSpecializationInfo                    info;
+};
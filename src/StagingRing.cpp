@@ -0,0 +1,349 @@
+#include "StagingRing.h"
+
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+#include <vulkan/vk_enum_string_helper.h>
+
+void StagingRing::init(VkDevice device, MemoryAllocator& allocator, const UploadQueues& queues, VkDeviceSize size)
+{
+    this->device    = device;
+    this->allocator = &allocator;
+    this->queues    = queues;
+    ringSize        = size;
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags              = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex   = queues.transferFamily;
+
+    VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to create Upload CommandPool");
+    }
+    if (usesTransferQueue()) {
+        poolInfo.queueFamilyIndex = queues.graphicsFamily;
+        result = vkCreateCommandPool(device, &poolInfo, nullptr, &acquireCommandPool);
+        if (result != VK_SUCCESS) {
+            std::cerr << string_VkResult(result) << std::endl;
+            throw std::runtime_error("[VULKAN] Failed to create Upload CommandPool");
+        }
+    }
+
+    if (queues.timelineSemaphores) {
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType  = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue   = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType     = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext     = &typeInfo;
+
+        result = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timelineSemaphore);
+        if (result != VK_SUCCESS) {
+            std::cerr << string_VkResult(result) << std::endl;
+            throw std::runtime_error("[VULKAN] Failed to create Timeline Semaphore");
+        }
+    }
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType        = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size         = ringSize;
+    bufferInfo.usage        = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode  = VK_SHARING_MODE_EXCLUSIVE;
+
+    result = vkCreateBuffer(device, &bufferInfo, nullptr, &ringBuffer);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to create Staging Ring Buffer");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, ringBuffer, &memRequirements);
+    ringMemory = allocator.allocate(memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ALLOCATION_KIND_LINEAR);
+    vkBindBufferMemory(device, ringBuffer, ringMemory.memory, ringMemory.offset);
+
+    std::cout << "[UPLOAD] Staging ring of " << ringSize / 1024 << " KB on the " << (usesTransferQueue() ? "transfer" : "graphics") << " queue, "
+              << (queues.timelineSemaphores ? "timeline semaphore" : "fences") << std::endl;
+}
+
+void StagingRing::destroy()
+{
+    waitIdle();
+    for (const UploadBatch& batch : freeBatches) {
+        if (batch.fence != VK_NULL_HANDLE) {
+            vkDestroyFence(device, batch.fence, nullptr);
+        }
+    }
+    freeBatches.clear();
+    pendingCopies.clear();
+    if (timelineSemaphore != VK_NULL_HANDLE) {
+        vkDestroySemaphore(device, timelineSemaphore, nullptr);
+    }
+    if (acquireCommandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(device, acquireCommandPool, nullptr);
+    }
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroyBuffer(device, ringBuffer, nullptr);
+    allocator->free(ringMemory);
+}
+
+void* StagingRing::stage(VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size)
+{
+    if (size > ringSize) {
+        throw std::runtime_error("[UPLOAD] Staged copy is larger than the staging ring");
+    }
+
+    // Copies never straddle the end of the ring, the tail is skipped and counted as used until its batch retires
+    VkDeviceSize offset;
+    VkDeviceSize reserved;
+    while (true) {
+        if (ringUsed == 0) {
+            ringHead = 0;
+        }
+        offset = (ringHead + STAGING_RING_ALIGNMENT - 1) / STAGING_RING_ALIGNMENT * STAGING_RING_ALIGNMENT;
+        if (offset + size > ringSize) {
+            offset = 0;
+        }
+        reserved = (offset >= ringHead ? offset - ringHead : ringSize - ringHead) + size;
+        if (ringUsed + reserved <= ringSize) {
+            break;
+        }
+        // Everything still pending is older than this copy, submit it so the GPU can drain the ring
+        if (inFlightBatches.empty()) {
+            flush();
+        }
+        retireOldest();
+    }
+
+    ringHead = offset + size;
+    ringUsed += reserved;
+    pendingBytes += reserved;
+
+    PendingCopy copy{};
+    copy.dst                = dst;
+    copy.region.srcOffset   = offset;
+    copy.region.dstOffset   = dstOffset;
+    copy.region.size        = size;
+    pendingCopies.push_back(copy);
+
+    return static_cast<char*>(ringMemory.mapped) + offset;
+}
+
+void StagingRing::upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+    const char* src = static_cast<const char*>(data);
+    VkDeviceSize maxChunk = ringSize / 2;
+    for (VkDeviceSize done = 0; done < size; ) {
+        VkDeviceSize chunk = std::min(size - done, maxChunk);
+        memcpy(stage(dst, dstOffset + done, chunk), src + done, (size_t) chunk);
+        done += chunk;
+    }
+}
+
+VkCommandBuffer StagingRing::allocateCommandBuffer(VkCommandPool pool)
+{
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType                 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level                 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool           = pool;
+    allocInfo.commandBufferCount    = 1;
+
+    VkCommandBuffer commandBuffer;
+    VkResult result = vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to allocate Upload CommandBuffer");
+    }
+    return commandBuffer;
+}
+
+// Release and acquire halves of the queue family ownership transfer, both sides must describe the same buffer ranges
+void StagingRing::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<VkBuffer>& buffers, bool acquire)
+{
+    std::vector<VkBufferMemoryBarrier> barriers(buffers.size());
+    for (size_t i = 0; i < buffers.size(); i++) {
+        barriers[i].sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barriers[i].srcAccessMask       = acquire ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[i].dstAccessMask       = acquire ? VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                                                    VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT : 0;
+        barriers[i].srcQueueFamilyIndex = queues.transferFamily;
+        barriers[i].dstQueueFamilyIndex = queues.graphicsFamily;
+        barriers[i].buffer              = buffers[i];
+        barriers[i].offset              = 0;
+        barriers[i].size                = VK_WHOLE_SIZE;
+    }
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        acquire ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT,
+        acquire ? VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr
+    );
+}
+
+void StagingRing::submit(VkQueue queue, VkCommandBuffer commandBuffer, uint64_t waitValue, uint64_t signalValue, VkFence fence)
+{
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType                      = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount    = waitValue > 0 ? 1 : 0;
+    timelineInfo.pWaitSemaphoreValues       = &waitValue;
+    timelineInfo.signalSemaphoreValueCount  = 1;
+    timelineInfo.pSignalSemaphoreValues     = &signalValue;
+
+    // The acquire submit only holds barriers, stalling all of it until the copies are done costs nothing
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount   = 1;
+    submitInfo.pCommandBuffers      = &commandBuffer;
+    if (queues.timelineSemaphores) {
+        submitInfo.pNext                = &timelineInfo;
+        submitInfo.waitSemaphoreCount   = waitValue > 0 ? 1 : 0;
+        submitInfo.pWaitSemaphores      = &timelineSemaphore;
+        submitInfo.pWaitDstStageMask    = &waitStage;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores    = &timelineSemaphore;
+    }
+
+    VkResult result = vkQueueSubmit(queue, 1, &submitInfo, fence);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to submit Upload CommandBuffer");
+    }
+}
+
+void StagingRing::flush()
+{
+    if (pendingCopies.empty()) {
+        return;
+    }
+
+    UploadBatch batch{};
+    if (!freeBatches.empty()) {
+        batch = freeBatches.back();
+        freeBatches.pop_back();
+        vkResetCommandBuffer(batch.commandBuffer, 0);
+    }
+    else {
+        batch.commandBuffer = allocateCommandBuffer(commandPool);
+        if (usesTransferQueue()) {
+            batch.acquireCommandBuffer = allocateCommandBuffer(acquireCommandPool);
+        }
+        if (!queues.timelineSemaphores) {
+            VkFenceCreateInfo fenceInfo{};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            VkResult result = vkCreateFence(device, &fenceInfo, nullptr, &batch.fence);
+            if (result != VK_SUCCESS) {
+                std::cerr << string_VkResult(result) << std::endl;
+                throw std::runtime_error("[VULKAN] Failed to create Fence");
+            }
+        }
+    }
+    batch.ringBytes = pendingBytes;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+    // Consecutive copies into the same buffer share one vkCmdCopyBuffer
+    std::vector<VkBufferCopy> regions;
+    std::vector<VkBuffer> dstBuffers;
+    for (size_t i = 0; i < pendingCopies.size(); i++) {
+        regions.push_back(pendingCopies[i].region);
+        if (i + 1 == pendingCopies.size() || pendingCopies[i + 1].dst != pendingCopies[i].dst) {
+            vkCmdCopyBuffer(batch.commandBuffer, ringBuffer, pendingCopies[i].dst, static_cast<uint32_t>(regions.size()), regions.data());
+            regions.clear();
+        }
+        if (std::find(dstBuffers.begin(), dstBuffers.end(), pendingCopies[i].dst) == dstBuffers.end()) {
+            dstBuffers.push_back(pendingCopies[i].dst);
+        }
+    }
+
+    if (usesTransferQueue()) {
+        recordBarriers(batch.commandBuffer, dstBuffers, false);
+        vkEndCommandBuffer(batch.commandBuffer);
+
+        vkResetCommandBuffer(batch.acquireCommandBuffer, 0);
+        vkBeginCommandBuffer(batch.acquireCommandBuffer, &beginInfo);
+        recordBarriers(batch.acquireCommandBuffer, dstBuffers, true);
+        vkEndCommandBuffer(batch.acquireCommandBuffer);
+
+        // transfer: copies + release -> copiesDone, graphics: wait copiesDone, acquire -> batch done
+        uint64_t copiesDone = ++timelineValue;
+        batch.timelineValue = ++timelineValue;
+        submit(queues.transferQueue, batch.commandBuffer, 0, copiesDone, VK_NULL_HANDLE);
+        submit(queues.graphicsQueue, batch.acquireCommandBuffer, copiesDone, batch.timelineValue, VK_NULL_HANDLE);
+    }
+    else {
+        VkMemoryBarrier barrier{};
+        barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask   = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                                  VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(
+            batch.commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr
+        );
+        vkEndCommandBuffer(batch.commandBuffer);
+
+        batch.timelineValue = queues.timelineSemaphores ? ++timelineValue : 0;
+        submit(queues.transferQueue, batch.commandBuffer, 0, batch.timelineValue, batch.fence);
+    }
+
+    inFlightBatches.push_back(batch);
+    pendingCopies.clear();
+    pendingBytes = 0;
+}
+
+bool StagingRing::isComplete(const UploadBatch& batch)
+{
+    if (queues.timelineSemaphores) {
+        uint64_t value = 0;
+        vkGetSemaphoreCounterValue(device, timelineSemaphore, &value);
+        return value >= batch.timelineValue;
+    }
+    return vkGetFenceStatus(device, batch.fence) == VK_SUCCESS;
+}
+
+void StagingRing::retireOldest()
+{
+    UploadBatch batch = inFlightBatches.front();
+    if (queues.timelineSemaphores) {
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores    = &timelineSemaphore;
+        waitInfo.pValues        = &batch.timelineValue;
+        vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+    }
+    else {
+        vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+        vkResetFences(device, 1, &batch.fence);
+    }
+    ringUsed -= batch.ringBytes;
+    inFlightBatches.pop_front();
+    freeBatches.push_back(batch);
+}
+
+void StagingRing::retire()
+{
+    while (!inFlightBatches.empty() && isComplete(inFlightBatches.front())) {
+        retireOldest();
+    }
+}
+
+void StagingRing::waitIdle()
+{
+    while (!inFlightBatches.empty()) {
+        retireOldest();
+    }
+}
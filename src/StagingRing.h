@@ -0,0 +1,93 @@
+#pragma once
+
+#include "MemoryAllocator.h"
+
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+// Persistent upload ring
+// One host-visible staging buffer, mapped for its whole lifetime, is handed out front to back. Staged copies
+// are collected until flush, which records all of them into a single command buffer and submits it without waiting.
+// Ring space of a batch is reclaimed once the GPU is done with it, stage only blocks when the ring is full of copies
+// the GPU hasn't consumed yet.
+//
+// With a dedicated transfer queue the copies run there and end with queue family release barriers, a second
+// submit on the graphics queue waits for them on a timeline semaphore and records the matching acquire barriers.
+// Destination buffers stay VK_SHARING_MODE_EXCLUSIVE and belong to the graphics family afterwards. The transfer
+// queue never acquires them back, so a buffer should only be staged into again once graphics no longer reads it
+// and without relying on the bytes outside the staged ranges.
+const VkDeviceSize STAGING_RING_SIZE        = 16ull * 1024 * 1024;
+const VkDeviceSize STAGING_RING_ALIGNMENT   = 16;
+
+struct UploadQueues {
+    VkQueue     transferQueue;
+    uint32_t    transferFamily;
+    VkQueue     graphicsQueue;
+    uint32_t    graphicsFamily;
+    bool        timelineSemaphores;     // Track batches with one timeline semaphore instead of a fence per batch
+};
+
+class StagingRing
+{
+public:
+    StagingRing() = default;
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+
+    // A transferFamily that differs from graphicsFamily requires timelineSemaphores
+    void init(VkDevice device, MemoryAllocator& allocator, const UploadQueues& queues, VkDeviceSize size = STAGING_RING_SIZE);
+    // Waits for every submitted batch, staged copies that were never flushed are dropped
+    void destroy();
+
+    // Reserves size bytes (at most capacity()) to be copied into dst at dstOffset by the next flush, returns where to write them
+    void* stage(VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size);
+    // Stages data of any size, splitting it into ring-sized copies
+    void upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+    // Submits every staged copy in one command buffer. Once the graphics queue side of the batch is submitted, later
+    // graphics submissions see the data in vertex input, index fetch, indirect reads and shaders.
+    void flush();
+    // Reclaims the ring space of finished batches, never blocks
+    void retire();
+    void waitIdle();
+
+    VkDeviceSize capacity() const { return ringSize; }
+    bool usesTransferQueue() const { return queues.transferFamily != queues.graphicsFamily; }
+
+private:
+    struct PendingCopy {
+        VkBuffer        dst;
+        VkBufferCopy    region;
+    };
+
+    struct UploadBatch {
+        VkCommandBuffer commandBuffer;
+        VkCommandBuffer acquireCommandBuffer;   // Graphics queue half of the ownership transfer, transfer queue only
+        VkFence         fence;                  // Without timeline semaphores only
+        uint64_t        timelineValue;          // Signalled once the whole batch has executed
+        VkDeviceSize    ringBytes;              // Ring space to give back when done, including wrap padding
+    };
+
+    VkCommandBuffer allocateCommandBuffer(VkCommandPool pool);
+    void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<VkBuffer>& buffers, bool acquire);
+    void submit(VkQueue queue, VkCommandBuffer commandBuffer, uint64_t waitValue, uint64_t signalValue, VkFence fence);
+    bool isComplete(const UploadBatch& batch);
+    void retireOldest();
+
+    VkDevice                    device                  = VK_NULL_HANDLE;
+    MemoryAllocator*            allocator               = nullptr;
+    UploadQueues                queues{};
+    VkCommandPool               commandPool             = VK_NULL_HANDLE;
+    VkCommandPool               acquireCommandPool      = VK_NULL_HANDLE;
+    VkSemaphore                 timelineSemaphore       = VK_NULL_HANDLE;
+    uint64_t                    timelineValue           = 0;
+    VkBuffer                    ringBuffer              = VK_NULL_HANDLE;
+    MemoryAllocation            ringMemory;
+    VkDeviceSize                ringSize                = 0;
+    VkDeviceSize                ringHead                = 0;
+    VkDeviceSize                ringUsed                = 0;    // Bytes between the oldest in-flight batch and ringHead
+    VkDeviceSize                pendingBytes            = 0;
+    std::vector<PendingCopy>    pendingCopies;
+    std::deque<UploadBatch>     inFlightBatches;
+    std::vector<UploadBatch>    freeBatches;
+};
@@ -5,13 +5,23 @@
 #include <set>
 #include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <cmath>
+#include <thread>
+#include <filesystem>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
 #include <vulkan/vk_enum_string_helper.h>
 
-Swiftcanon::Swiftcanon()
-    :requiredValidationLayers({
+// Generated at build time from src/shaders, see cmake/EmbedSpirv.cmake
+#include "shader.vert.h"
+#include "shader.frag.h"
+#include "cull.comp.h"
+#include "instance_cull.comp.h"
+#include "hiz_build.comp.h"
+
+Swiftcanon::Swiftcanon(const SwiftcanonOptions& options)
+    :options(options),
+    requiredValidationLayers({
         "VK_LAYER_KHRONOS_validation"
     }),
     requiredVulkanExtensions({
@@ -24,45 +34,99 @@ Swiftcanon::Swiftcanon()
         #ifdef APPLE
             "VK_KHR_portability_subset",
         #endif
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME
-    })
-{}
+    }),
+    vertexLayout(VertexLayout::get(options.vertexFormat)),
+    benchmark(options.warmupFrames)
+{
+    if (!options.headless) {
+        requiredDeviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+    // Enabled before init so the startup steps are part of the trace
+    if (!options.cpuTrace.empty()) {
+        CpuProfiler::setEnabled(true);
+        CpuProfiler::setThreadName("main");
+    }
+}
 
 void Swiftcanon::init()
 {
-    initWindow();
+    if (!options.headless) {
+        initWindow();
+    }
     initVulkan();
+    // Keeps the startup steps out of the rings, frames would overwrite them on long runs
+    CpuProfiler::endStartup();
 }
 
 void Swiftcanon::run()
 {
     mainLoop();
+    if (options.benchmark) {
+        writeBenchmarkReport();
+    }
+    writeCpuTrace();
     cleanup();
 }
 
+void Swiftcanon::writeCpuTrace()
+{
+    if (options.cpuTrace.empty()) {
+        return;
+    }
+    if (CpuProfiler::writeChromeTrace(options.cpuTrace)) {
+        std::cout << "[PROFILER] CPU trace written to " << options.cpuTrace << std::endl;
+    }
+    else {
+        std::cerr << "[PROFILER] Failed to write CPU trace to " << options.cpuTrace << std::endl;
+    }
+}
+
 static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
     Swiftcanon* app = reinterpret_cast<Swiftcanon*>(glfwGetWindowUserPointer(window));
     app->framebufferResized = true;
 }
 
+static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    Swiftcanon* app = reinterpret_cast<Swiftcanon*>(glfwGetWindowUserPointer(window));
+    if (key == GLFW_KEY_TAB && action == GLFW_PRESS) {
+        app->cycleShadingMode();
+    }
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        app->writeCpuTrace();
+    }
+}
+
 void Swiftcanon::initWindow()
 {
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    window = glfwCreateWindow(800, 600, "Vulkan", nullptr, nullptr);
+    window = glfwCreateWindow(static_cast<int>(options.width), static_cast<int>(options.height), "Vulkan", nullptr, nullptr);
     glfwSetWindowUserPointer(window, this);
     glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+    glfwSetKeyCallback(window, keyCallback);
     std::cout << "[GLFW] Vulkan Window Created" << std::endl;
 }
 
 void Swiftcanon::initVulkan()
 {
+    CpuProfileScope scope("initVulkan");
     addVulkanValidationLayers();
     addVulkanInstanceExtensions();
     createVulkanInstance();
     createSurface();
     pickPhysicalGraphicsDevice();
     createVulkanLogicalDevice();
+    memoryAllocator.init(physicalDevice, device);
+    UploadQueues uploadQueues{};
+    uploadQueues.transferQueue      = transferQueue;
+    uploadQueues.transferFamily     = physicalDeviceIndices.transferFamily.value_or(physicalDeviceIndices.graphicsFamily.value());
+    uploadQueues.graphicsQueue      = graphicsQueue;
+    uploadQueues.graphicsFamily     = physicalDeviceIndices.graphicsFamily.value();
+    uploadQueues.timelineSemaphores = physicalDeviceDetails.timelineSemaphores;
+    stagingRing.init(device, memoryAllocator, uploadQueues);
+    createPipelineCache();
+    // Leaves cores for the main thread and the OS, compiles are spread over the rest
+    pipelineManager.init(device, std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u));
     createSwapChain();
     createImageViews();
     createRenderPass();
@@ -73,12 +137,31 @@ void Swiftcanon::initVulkan()
     createCommandPool();
     createCommandBuffer();
     loadModel("src/models/bunny.obj");
+    createInstances();
     createVertexBuffer();
     createIndexBuffer();
+    createCullPipeline();
+    createCullBuffers();
+    createInstanceCullPipeline();
+    createInstanceCullBuffers();
+    createHiZPipeline();
+    createHiZResources();
+    // Every mesh upload above goes out in one submit, the first frame is queued behind it
+    stagingRing.flush();
     createUniformBuffers();
     createDescriptorPool();
     createDescriptorSets();
     createSyncObjects();
+    createGpuProfiler();
+    createPipelineStatsQueries();
+    memoryAllocator.logStats();
+    // Benchmarks wait as well, fallback frames would make the warm-up length matter
+    if (!options.asyncPipelines || options.benchmark) {
+        CpuProfileScope scope("wait for pipelines");
+        for (PipelineHandle pipeline : {graphicsPipelineVariant(shaderFeatures), cullPipeline, instanceCullPipeline, hiZPipeline}) {
+            pipelineManager.wait(pipeline);
+        }
+    }
 }
 
 void Swiftcanon::addVulkanValidationLayers()
@@ -117,10 +200,13 @@ void Swiftcanon::addVulkanInstanceExtensions()
     vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
     std::cout << "[VULKAN] " << extensionCount << " Vulkan Instance Extensions available" << std::endl;
 
-    uint32_t requiredExtensionCount;
-    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&requiredExtensionCount);
-    for (size_t i = 0; i < requiredExtensionCount; i++) {
-        requiredVulkanExtensions.push_back(glfwExtensions[i]);
+    // Headless runs need no surface extensions, so they also work on drivers without any
+    if (!options.headless) {
+        uint32_t requiredExtensionCount;
+        const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&requiredExtensionCount);
+        for (size_t i = 0; i < requiredExtensionCount; i++) {
+            requiredVulkanExtensions.push_back(glfwExtensions[i]);
+        }
     }
     std::cout << "[VULKAN] " << requiredVulkanExtensions.size() << " Vulkan Instance Extensions enabled:" << std::endl;
 
@@ -131,8 +217,28 @@ void Swiftcanon::addVulkanInstanceExtensions()
 
 void Swiftcanon::createVulkanInstance()
 {
+    CpuProfileScope scope("createVulkanInstance");
+    // 1.2 for timeline semaphores, devices below that still work without the transfer queue. A 1.0 loader
+    // rejects any higher apiVersion and has no vkEnumerateInstanceVersion, so it is looked up instead of linked.
+    PFN_vkEnumerateInstanceVersion enumerateInstanceVersion =
+        reinterpret_cast<PFN_vkEnumerateInstanceVersion>(vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+    uint32_t loaderVersion = VK_API_VERSION_1_0;
+    if (enumerateInstanceVersion != nullptr && enumerateInstanceVersion(&loaderVersion) != VK_SUCCESS) {
+        loaderVersion = VK_API_VERSION_1_0;
+    }
+    instanceApiVersion = loaderVersion >= VK_API_VERSION_1_2 ? VK_API_VERSION_1_2 : VK_API_VERSION_1_0;
+
+    VkApplicationInfo appInfo{};
+    appInfo.sType                       = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName            = "Swiftcanon";
+    appInfo.applicationVersion          = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.pEngineName                 = "Swiftcanon";
+    appInfo.engineVersion               = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.apiVersion                  = instanceApiVersion;
+
     VkInstanceCreateInfo createInfo{};
     createInfo.sType                    = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    createInfo.pApplicationInfo         = &appInfo;
     #ifdef APPLE
         createInfo.flags                = VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
     #endif
@@ -155,6 +261,9 @@ void Swiftcanon::createVulkanInstance()
 
 void Swiftcanon::createSurface()
 {
+    if (options.headless) {
+        return;
+    }
     VkResult result = glfwCreateWindowSurface(vkInstance, window, nullptr, &surface);
     if (result != VK_SUCCESS) {
         std::cerr << string_VkResult(result) << std::endl;
@@ -164,6 +273,7 @@ void Swiftcanon::createSurface()
 
 void Swiftcanon::pickPhysicalGraphicsDevice()
 {
+    CpuProfileScope scope("pickPhysicalGraphicsDevice");
     uint32_t deviceCount = 0;
     vkEnumeratePhysicalDevices(vkInstance, &deviceCount, nullptr);
 
@@ -198,6 +308,12 @@ void Swiftcanon::pickPhysicalGraphicsDevice()
             std::cout << "[VULKAN]   QueueFamily Indices:" << std::endl;
             std::cout << "[VULKAN]     Graphics:     " << physicalDeviceIndices.graphicsFamily.value() << std::endl;
             std::cout << "[VULKAN]     Presentation: " << physicalDeviceIndices.presentFamily.value() << std::endl;
+            if (physicalDeviceIndices.transferFamily.has_value()) {
+                std::cout << "[VULKAN]     Transfer:     " << physicalDeviceIndices.transferFamily.value() << std::endl;
+            }
+            else {
+                std::cout << "[VULKAN]     Transfer:     none, uploads run on the graphics queue" << std::endl;
+            }
         }
         else {
             throw std::runtime_error("[Vulkan] Failed to find a suitable GPU");
@@ -211,6 +327,7 @@ void Swiftcanon::pickPhysicalGraphicsDevice()
 
 void Swiftcanon::createVulkanLogicalDevice()
 {
+    CpuProfileScope scope("createVulkanLogicalDevice");
     std::cout << "[VULKAN] " << physicalDeviceDetails.extensionCount << " Device Extensions available" << std::endl;
 
     std::cout << "[VULKAN] " << requiredDeviceExtensions.size() << " Device Extensions enabled:" << std::endl;
@@ -220,6 +337,9 @@ void Swiftcanon::createVulkanLogicalDevice()
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = { physicalDeviceIndices.graphicsFamily.value(), physicalDeviceIndices.presentFamily.value() };
+    if (physicalDeviceIndices.transferFamily.has_value()) {
+        uniqueQueueFamilies.insert(physicalDeviceIndices.transferFamily.value());
+    }
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -231,10 +351,23 @@ void Swiftcanon::createVulkanLogicalDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    // Optional features are enabled whenever the device has them, the draw paths check physicalDeviceDetails
     VkPhysicalDeviceFeatures deviceFeatures{};
+    deviceFeatures.multiDrawIndirect = physicalDeviceDetails.multiDrawIndirect ? VK_TRUE : VK_FALSE;
+    deviceFeatures.drawIndirectFirstInstance = physicalDeviceDetails.drawIndirectFirstInstance ? VK_TRUE : VK_FALSE;
+    deviceFeatures.pipelineStatisticsQuery = physicalDeviceDetails.pipelineStatisticsQuery ? VK_TRUE : VK_FALSE;
+    deviceFeatures.inheritedQueries = physicalDeviceDetails.inheritedQueries ? VK_TRUE : VK_FALSE;
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = physicalDeviceDetails.timelineSemaphores ? VK_TRUE : VK_FALSE;
+    vulkan12Features.drawIndirectCount = physicalDeviceDetails.drawIndirectCount ? VK_TRUE : VK_FALSE;
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    if (physicalDeviceDetails.timelineSemaphores || physicalDeviceDetails.drawIndirectCount) {
+        createInfo.pNext = &vulkan12Features;
+    }
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
@@ -252,6 +385,10 @@ void Swiftcanon::createVulkanLogicalDevice()
     if (result == VK_SUCCESS) {
         vkGetDeviceQueue(device, physicalDeviceIndices.graphicsFamily.value(), 0, &graphicsQueue);
         vkGetDeviceQueue(device, physicalDeviceIndices.presentFamily.value(), 0, &presentQueue);
+        transferQueue = graphicsQueue;
+        if (physicalDeviceIndices.transferFamily.has_value()) {
+            vkGetDeviceQueue(device, physicalDeviceIndices.transferFamily.value(), 0, &transferQueue);
+        }
     }
     else {
         std::cerr << string_VkResult(result) << std::endl;
@@ -261,6 +398,12 @@ void Swiftcanon::createVulkanLogicalDevice()
 
 void Swiftcanon::createSwapChain()
 {
+    CpuProfileScope scope("createSwapChain");
+    if (options.headless) {
+        createOffscreenTargets();
+        return;
+    }
+
     VkSurfaceCapabilitiesKHR capabilities;
     VkSurfaceFormatKHR surfaceFormat;
     VkPresentModeKHR presentMode;
@@ -358,7 +501,7 @@ void Swiftcanon::createSwapChain()
     createInfo.compositeAlpha               = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode                  = presentMode;
     createInfo.clipped                      = VK_TRUE;
-    createInfo.oldSwapchain                 = VK_NULL_HANDLE;
+    createInfo.oldSwapchain                 = swapChain;    // Retired by this call, destroyed later by cleanupSwapChain's deferred deletion
 
     VkResult result = vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain);
     if (result == VK_SUCCESS) {
@@ -371,8 +514,33 @@ void Swiftcanon::createSwapChain()
     }
 }
 
+// Headless frames render into one color image per frame in flight, drawFrame uses currentFrame as the image index.
+// They end up in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, ready to be copied out.
+void Swiftcanon::createOffscreenTargets()
+{
+    swapChainImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    swapChainExtent = {options.width, options.height};
+    swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+    offscreenImagesMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+        createImage(
+            swapChainExtent.width,
+            swapChainExtent.height,
+            swapChainImageFormat,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            swapChainImages[i],
+            offscreenImagesMemory[i]
+        );
+    }
+    std::cout << "[VULKAN] Headless: " << swapChainImages.size() << " offscreen targets, "
+              << swapChainExtent.width << "x" << swapChainExtent.height << std::endl;
+}
+
 void Swiftcanon::recreateSwapChain()
 {
+    CpuProfileScope scope("recreateSwapChain");
     int width = 0, height = 0;
     glfwGetFramebufferSize(window, &width, &height);
     while (width == 0 || height == 0) {
@@ -380,28 +548,67 @@ void Swiftcanon::recreateSwapChain()
         glfwWaitEvents();
     }
 
-    vkDeviceWaitIdle(device);
-    
+    // No wait for the GPU, the frame in flight keeps rendering with the old objects while the new ones are created.
+    // The old swapchain is passed on as oldSwapchain, everything else is deleted once the frames using it are done.
     cleanupSwapChain();
+    uint32_t threadCount = recordWorkers->size();
+    uint32_t imageCount = static_cast<uint32_t>(swapChainImages.size());
+    deferDeletion([this, threadCount, imageCount, primaries = commandBuffers, secondaries = secondaryCommandBuffers]() {
+        vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(primaries.size()), primaries.data());
+        for (size_t i = 0; i < secondaries.size(); i++) {
+            uint32_t frame = static_cast<uint32_t>(i / threadCount / imageCount);
+            uint32_t thread = static_cast<uint32_t>(i % threadCount);
+            vkFreeCommandBuffers(device, recordCommandPools[frame * threadCount + thread], 1, &secondaries[i]);
+        }
+    });
 
     createSwapChain();
     createImageViews();
     createDepthResources();
+    createHiZResources();
     createFramebuffers();
+    createCommandBuffer();
+    commandBufferEpoch++;
 }
 
 void Swiftcanon::cleanupSwapChain()
 {
-    vkDestroyImageView(device, depthImageView, nullptr);
-    vkDestroyImage(device, depthImage, nullptr);
-    vkFreeMemory(device, depthImageMemory, nullptr);
-    for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
-        vkDestroyFramebuffer(device, swapChainFramebuffers[i], nullptr);
-    }
-    for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-        vkDestroyImageView(device, swapChainImageViews[i], nullptr);
+    // Handles are copied into the deletion, the members stay valid until their replacements are created
+    cleanupHiZResources();
+    deferDeletion([this, depthImageView = depthImageView, depthImage = depthImage, depthImageMemory = depthImageMemory,
+                   framebuffers = swapChainFramebuffers, imageViews = swapChainImageViews, swapChain = swapChain,
+                   offscreenImages = swapChainImages, offscreenImagesMemory = offscreenImagesMemory]() mutable {
+        vkDestroyImageView(device, depthImageView, nullptr);
+        vkDestroyImage(device, depthImage, nullptr);
+        memoryAllocator.free(depthImageMemory);
+        for (size_t i = 0; i < framebuffers.size(); i++) {
+            vkDestroyFramebuffer(device, framebuffers[i], nullptr);
+        }
+        for (size_t i = 0; i < imageViews.size(); i++) {
+            vkDestroyImageView(device, imageViews[i], nullptr);
+        }
+        // Headless devices are created without VK_KHR_swapchain, its commands must not be called there
+        if (swapChain != VK_NULL_HANDLE) {
+            vkDestroySwapchainKHR(device, swapChain, nullptr);
+        }
+        for (size_t i = 0; i < offscreenImagesMemory.size(); i++) {
+            vkDestroyImage(device, offscreenImages[i], nullptr);
+            memoryAllocator.free(offscreenImagesMemory[i]);
+        }
+    });
+}
+
+void Swiftcanon::deferDeletion(std::function<void()> destroy)
+{
+    deletionQueue.push_back({submittedFrames, std::move(destroy)});
+}
+
+void Swiftcanon::runDeferredDeletions(uint64_t completedFrames)
+{
+    while (!deletionQueue.empty() && deletionQueue.front().frame <= completedFrames) {
+        deletionQueue.front().destroy();
+        deletionQueue.pop_front();
     }
-    vkDestroySwapchainKHR(device, swapChain, nullptr);
 }
 
 void Swiftcanon::createImageViews()
@@ -431,17 +638,125 @@ void Swiftcanon::createImageViews()
     }
 }
 
+// Drivers are supposed to ignore foreign cache data, but not all of them check, so the header is compared first
+static bool validatePipelineCache(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties)
+{
+    VkPipelineCacheHeaderVersionOne header{};
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    return header.headerSize >= sizeof(header)
+        && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header.vendorID == properties.vendorID
+        && header.deviceID == properties.deviceID
+        && memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void Swiftcanon::createPipelineCache()
+{
+    CpuProfileScope scope("createPipelineCache");
+    std::vector<char> data;
+    if (options.pipelineCache) {
+        std::ifstream file(PIPELINE_CACHE_PATH, std::ios::ate | std::ios::binary);
+        if (file.is_open()) {
+            data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!file) {
+                data.clear();
+            }
+        }
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    pipelineCacheLoaded = validatePipelineCache(data, properties);
+    if (!options.pipelineCache) {
+        std::cout << "[VULKAN] Pipeline cache disabled" << std::endl;
+    }
+    else if (pipelineCacheLoaded) {
+        std::cout << "[VULKAN] Loaded pipeline cache " << PIPELINE_CACHE_PATH << " (" << data.size() << " bytes)" << std::endl;
+    }
+    else if (!data.empty()) {
+        std::cout << "[VULKAN] Pipeline cache " << PIPELINE_CACHE_PATH << " is from another device or driver, compiling from scratch" << std::endl;
+    }
+    else {
+        std::cout << "[VULKAN] No pipeline cache at " << PIPELINE_CACHE_PATH << ", compiling from scratch" << std::endl;
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType             = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize   = pipelineCacheLoaded ? data.size() : 0;
+    cacheInfo.pInitialData      = pipelineCacheLoaded ? data.data() : nullptr;
+
+    VkResult result = vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to create Pipeline Cache");
+    }
+}
+
+void Swiftcanon::savePipelineCache()
+{
+    if (!options.pipelineCache) {
+        return;
+    }
+
+    size_t size = 0;
+    VkResult result = vkGetPipelineCacheData(device, pipelineCache, &size, nullptr);
+    std::vector<char> data(size);
+    if (result == VK_SUCCESS) {
+        result = vkGetPipelineCacheData(device, pipelineCache, &size, data.data());
+    }
+    if (result != VK_SUCCESS) {
+        std::cout << "[VULKAN] WARNING: Failed to read pipeline cache data: " << string_VkResult(result) << std::endl;
+        return;
+    }
+
+    // Written next to the final file and renamed over it, an interrupted save never leaves a torn cache behind
+    std::string temporaryPath = std::string(PIPELINE_CACHE_PATH) + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(size));
+        if (!file) {
+            std::cout << "[VULKAN] WARNING: Failed to write pipeline cache " << temporaryPath << std::endl;
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, PIPELINE_CACHE_PATH, error);
+    if (error) {
+        std::filesystem::remove(temporaryPath, error);
+        std::cout << "[VULKAN] WARNING: Failed to replace pipeline cache " << PIPELINE_CACHE_PATH << std::endl;
+    }
+}
+
 void Swiftcanon::createRenderPass()
 {
+    // VK_IMAGE_LAYOUT_PRESENT_SRC_KHR belongs to VK_KHR_swapchain, which headless devices don't enable
+    VkImageLayout outputLayout = options.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    createRenderPassVariant(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED, outputLayout, VK_ATTACHMENT_STORE_OP_DONT_CARE, renderPass);
+    // Occlusion culling splits the frame around the Hi-Z build, the early pass keeps its depth for the pyramid
+    // and the late pass continues on top of both attachments. All three share the swapchain framebuffers.
+    createRenderPassVariant(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_STORE_OP_STORE, earlyRenderPass);
+    createRenderPassVariant(VK_ATTACHMENT_LOAD_OP_LOAD, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, outputLayout, VK_ATTACHMENT_STORE_OP_DONT_CARE, lateRenderPass);
+}
+
+void Swiftcanon::createRenderPassVariant(VkAttachmentLoadOp loadOp, VkImageLayout colorInitialLayout, VkImageLayout colorFinalLayout,
+                                         VkAttachmentStoreOp depthStoreOp, VkRenderPass& pass)
+{
+    bool loadAttachments = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+
     VkAttachmentDescription colorAttachment{};
     colorAttachment.format          = swapChainImageFormat;
     colorAttachment.samples         = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp          = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.loadOp          = loadOp;
     colorAttachment.storeOp         = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp   = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout   = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout     = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.initialLayout   = colorInitialLayout;
+    colorAttachment.finalLayout     = colorFinalLayout;
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment   = 0;
@@ -450,11 +765,11 @@ void Swiftcanon::createRenderPass()
     VkAttachmentDescription depthAttachment{};
     depthAttachment.format          = findSupportedFormat({VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT}, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
     depthAttachment.samples         = VK_SAMPLE_COUNT_1_BIT;
-    depthAttachment.loadOp          = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp         = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.loadOp          = loadOp;
+    depthAttachment.storeOp         = depthStoreOp;
     depthAttachment.stencilLoadOp   = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout   = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.initialLayout   = loadAttachments ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
     depthAttachment.finalLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference depthAttachmentRef{};
@@ -471,9 +786,12 @@ void Swiftcanon::createRenderPass()
     dependency.srcSubpass           = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass           = 0;
     dependency.srcStageMask         = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.srcAccessMask        = 0;
+    dependency.srcAccessMask        = loadAttachments ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0;
     dependency.dstStageMask         = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     dependency.dstAccessMask        = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    if (loadAttachments) {
+        dependency.dstAccessMask    |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+    }
 
     std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
     VkRenderPassCreateInfo renderPassInfo{};
@@ -485,7 +803,7 @@ void Swiftcanon::createRenderPass()
     renderPassInfo.dependencyCount  = 1;
     renderPassInfo.pDependencies    = &dependency;
 
-    VkResult result = vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass);
+    VkResult result = vkCreateRenderPass(device, &renderPassInfo, nullptr, &pass);
     if (result != VK_SUCCESS) {
         std::cerr << string_VkResult(result) << std::endl;
         throw std::runtime_error("[VULKAN] Failed to create Render Pass");
@@ -515,11 +833,61 @@ void Swiftcanon::createDescriptorSetLayout()
 
 void Swiftcanon::createGraphicsPipeline()
 {
-    std::vector<char> vertShaderCode = readFile("src/shaders/compiled/vert.spv");
-    std::vector<char> fragShaderCode = readFile("src/shaders/compiled/frag.spv");
+    CpuProfileScope scope("createGraphicsPipeline");
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount           = 1;
+    pipelineLayoutInfo.pSetLayouts              = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount   = 0;        // Optional
+    pipelineLayoutInfo.pPushConstantRanges      = nullptr;  // Optional
+
+    VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to create Pipeline Layout");
+    }
+
+    shaderFeatures = makeShaderFeatures(vertexLayout.format, options.shadingMode);
+    drawnShaderFeatures = shaderFeatures;
+    graphicsPipelineVariant(shaderFeatures);
+}
+
+PipelineHandle Swiftcanon::graphicsPipelineVariant(ShaderFeatures features)
+{
+    auto variant = graphicsVariants.find(features);
+    if (variant != graphicsVariants.end()) {
+        return variant->second;
+    }
+    PipelineHandle handle = pipelineManager.compile("graphics (" + shaderFeaturesName(features) + ")",
+                                                    [this, features]() { return buildGraphicsPipeline(features); });
+    graphicsVariants.emplace(features, handle);
+    return handle;
+}
+
+VkPipeline Swiftcanon::selectGraphicsPipeline()
+{
+    // A variant that is still compiling is replaced by the last one drawn with, nothing waits for the compile
+    VkPipeline pipeline = pipelineManager.get(graphicsPipelineVariant(shaderFeatures));
+    if (pipeline != VK_NULL_HANDLE) {
+        drawnShaderFeatures = shaderFeatures;
+        return pipeline;
+    }
+    return pipelineManager.get(graphicsPipelineVariant(drawnShaderFeatures));
+}
+
+void Swiftcanon::cycleShadingMode()
+{
+    ShadingMode mode = static_cast<ShadingMode>((featureShadingMode(shaderFeatures) + 1) % SHADING_MODE_COUNT);
+    shaderFeatures = makeShaderFeatures(featureVertexFormat(shaderFeatures), mode);
+    commandBufferEpoch++;
+    std::cout << "[VULKAN] Shading mode " << shadingModeName(mode) << std::endl;
+}
 
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+// Runs on a pipeline compile thread, only reads state that is fixed once init is done
+VkPipeline Swiftcanon::buildGraphicsPipeline(ShaderFeatures features)
+{
+    VkShaderModule vertShaderModule = createShaderModule(SPIRV_SHADER_VERT, sizeof(SPIRV_SHADER_VERT));
+    VkShaderModule fragShaderModule = createShaderModule(SPIRV_SHADER_FRAG, sizeof(SPIRV_SHADER_FRAG));
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType   = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -527,11 +895,16 @@ void Swiftcanon::createGraphicsPipeline()
     vertShaderStageInfo.module  = vertShaderModule;
     vertShaderStageInfo.pName   = "main";
 
+    // The variant's features select the vertex decode and shading paths, the dead branches are compiled out
+    ShaderSpecialization specialization(features);
+    vertShaderStageInfo.pSpecializationInfo = &specialization.info;
+
     VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
     fragShaderStageInfo.sType   = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragShaderStageInfo.stage   = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragShaderStageInfo.module  = fragShaderModule;
     fragShaderStageInfo.pName   = "main";
+    fragShaderStageInfo.pSpecializationInfo = &specialization.info;
 
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
@@ -545,12 +918,14 @@ void Swiftcanon::createGraphicsPipeline()
     dynamicState.dynamicStateCount  = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates     = dynamicStates.data();
 
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = { vertexLayout.getBindingDescription(), InstanceData::getBindingDescription() };
+    auto attributeDescriptions = vertexLayout.getAttributeDescriptions();
+    auto instanceAttributeDescriptions = InstanceData::getAttributeDescriptions();
+    attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributeDescriptions.begin(), instanceAttributeDescriptions.end());
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount   = 1;
-    vertexInputInfo.pVertexBindingDescriptions      = &bindingDescription;
+    vertexInputInfo.vertexBindingDescriptionCount   = static_cast<uint32_t>(bindingDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions      = bindingDescriptions.data();
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
     vertexInputInfo.pVertexAttributeDescriptions    = attributeDescriptions.data();
 
@@ -559,24 +934,13 @@ void Swiftcanon::createGraphicsPipeline()
     inputAssembly.topology                          = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssembly.primitiveRestartEnable            = VK_FALSE;
 
-    VkViewport viewport{};
-    viewport.x          = 0.0f;
-    viewport.y          = 0.0f;
-    viewport.width      = (float) swapChainExtent.width;
-    viewport.height     = (float) swapChainExtent.height;
-    viewport.minDepth   = 0.0f;
-    viewport.maxDepth   = 1.0f;
-
-    VkRect2D scissor{};
-    scissor.offset      = {0, 0};
-    scissor.extent      = swapChainExtent;
-
+    // Viewport and scissor are dynamic, set in bindGraphicsState, so the pipeline survives swapchain resizes
     VkPipelineViewportStateCreateInfo viewportState{};
     viewportState.sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports    = &viewport;
+    viewportState.pViewports    = nullptr;
     viewportState.scissorCount  = 1;
-    viewportState.pScissors     = &scissor;
+    viewportState.pScissors     = nullptr;
 
     VkPipelineRasterizationStateCreateInfo rasterizer{};
     rasterizer.sType                    = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -600,10 +964,14 @@ void Swiftcanon::createGraphicsPipeline()
     multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
     multisampling.alphaToOneEnable      = VK_FALSE; // Optional
 
+    // The overdraw view counts every rasterized fragment, hidden ones included, so it adds them up without depth.
+    // With nothing in the depth buffer occlusion culling keeps every instance, the view shows what frustum culling leaves.
+    bool overdraw = featureShadingMode(features) == SHADING_MODE_OVERDRAW;
+
     VkPipelineDepthStencilStateCreateInfo depthStencil{};
     depthStencil.sType                  = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStencil.depthTestEnable        = VK_TRUE;
-    depthStencil.depthWriteEnable       = VK_TRUE;
+    depthStencil.depthTestEnable        = overdraw ? VK_FALSE : VK_TRUE;
+    depthStencil.depthWriteEnable       = overdraw ? VK_FALSE : VK_TRUE;
     depthStencil.depthCompareOp         = VK_COMPARE_OP_LESS;
     depthStencil.depthBoundsTestEnable  = VK_FALSE;
     depthStencil.minDepthBounds         = 0.0f; // Optional
@@ -614,9 +982,9 @@ void Swiftcanon::createGraphicsPipeline()
 
     VkPipelineColorBlendAttachmentState colorBlendAttachment{};
     colorBlendAttachment.colorWriteMask         = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable            = VK_FALSE;
-    colorBlendAttachment.srcColorBlendFactor    = VK_BLEND_FACTOR_ONE;  // Optional
-    colorBlendAttachment.dstColorBlendFactor    = VK_BLEND_FACTOR_ZERO; // Optional
+    colorBlendAttachment.blendEnable            = overdraw ? VK_TRUE : VK_FALSE;
+    colorBlendAttachment.srcColorBlendFactor    = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstColorBlendFactor    = overdraw ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ZERO;
     colorBlendAttachment.colorBlendOp           = VK_BLEND_OP_ADD;      // Optional
     colorBlendAttachment.srcAlphaBlendFactor    = VK_BLEND_FACTOR_ONE;  // Optional
     colorBlendAttachment.dstAlphaBlendFactor    = VK_BLEND_FACTOR_ZERO; // Optional
@@ -633,19 +1001,6 @@ void Swiftcanon::createGraphicsPipeline()
     colorBlending.blendConstants[2]             = 0.0f;                 // Optional
     colorBlending.blendConstants[3]             = 0.0f;                 // Optional
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount           = 1;
-    pipelineLayoutInfo.pSetLayouts              = &descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount   = 0;        // Optional
-    pipelineLayoutInfo.pPushConstantRanges      = nullptr;  // Optional
-
-    VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
-    if (result != VK_SUCCESS) {
-        std::cerr << string_VkResult(result) << std::endl;
-        throw std::runtime_error("[VULKAN] Failed to create Pipeline Layout");
-    }
-
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType                  = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipelineInfo.stageCount             = 2;
@@ -664,14 +1019,37 @@ void Swiftcanon::createGraphicsPipeline()
     pipelineInfo.basePipelineHandle     = VK_NULL_HANDLE;   // Optional
     pipelineInfo.basePipelineIndex      = -1;               // Optional
 
-    result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline);
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(device, fragShaderModule, nullptr);
+    vkDestroyShaderModule(device, vertShaderModule, nullptr);
     if (result != VK_SUCCESS) {
-        std::cerr << string_VkResult(result) << std::endl;
-        throw std::runtime_error("[VULKAN] Failed to create Graphics Pipeline");
+        throw std::runtime_error("[VULKAN] Failed to create Graphics Pipeline: " + std::string(string_VkResult(result)));
     }
+    return pipeline;
+}
 
-    vkDestroyShaderModule(device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+PipelineHandle Swiftcanon::compileComputePipeline(const std::string& name, const uint32_t* code, size_t size, VkPipelineLayout layout)
+{
+    return pipelineManager.compile(name, [this, name, code, size, layout]() {
+        VkShaderModule shaderModule = createShaderModule(code, size);
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType          = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType    = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage    = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module   = shaderModule;
+        pipelineInfo.stage.pName    = "main";
+        pipelineInfo.layout         = layout;
+
+        VkPipeline pipeline;
+        VkResult result = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+        vkDestroyShaderModule(device, shaderModule, nullptr);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("[VULKAN] Failed to create " + name + " Pipeline: " + std::string(string_VkResult(result)));
+        }
+        return pipeline;
+    });
 }
 
 void Swiftcanon::createFramebuffers()
@@ -712,11 +1090,14 @@ void Swiftcanon::createCommandPool()
         std::cerr << string_VkResult(result) << std::endl;
         throw std::runtime_error("[VULKAN] Failed to create CommandPool");
     }
+    createRecordCommandPools();
 }
 
 void Swiftcanon::createCommandBuffer()
 {
-    commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    // Recorded commands reference the swapchain framebuffer, so with caching every image gets its own per frame slot
+    commandBuffers.resize(MAX_FRAMES_IN_FLIGHT * swapChainImages.size());
+    recordedCommands.assign(commandBuffers.size(), RecordedCommands{});
 
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType                 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -729,11 +1110,61 @@ void Swiftcanon::createCommandBuffer()
         std::cerr << string_VkResult(result) << std::endl;
         throw std::runtime_error("[VULKAN] Failed to create CommandBuffer");
     }
+
+    if (recordWorkers->size() == 1) {
+        return;
+    }
+    // A thread's secondaries come from its pool of the frame slot they are submitted in
+    uint32_t threadCount = recordWorkers->size();
+    secondaryCommandBuffers.resize(commandBuffers.size() * threadCount);
+    for (uint32_t commandIndex = 0; commandIndex < commandBuffers.size(); commandIndex++) {
+        uint32_t frame = commandIndex / static_cast<uint32_t>(swapChainImages.size());
+        for (uint32_t thread = 0; thread < threadCount; thread++) {
+            allocInfo.commandPool           = recordCommandPools[frame * threadCount + thread];
+            allocInfo.level                 = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount    = 1;
+
+            result = vkAllocateCommandBuffers(device, &allocInfo, &secondaryCommandBuffers[commandIndex * threadCount + thread]);
+            if (result != VK_SUCCESS) {
+                std::cerr << string_VkResult(result) << std::endl;
+                throw std::runtime_error("[VULKAN] Failed to create secondary CommandBuffer");
+            }
+        }
+    }
+}
+
+void Swiftcanon::createRecordCommandPools()
+{
+    uint32_t threadCount = options.recordThreads;
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    recordWorkers = std::make_unique<WorkerPool>(threadCount);
+    if (threadCount == 1) {
+        return;
+    }
+
+    // Command pools are externally synchronized, so no two threads may record from the same one. Individual
+    // buffers are reset rather than whole pools since cached primaries keep referencing their secondaries.
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags              = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex   = physicalDeviceIndices.graphicsFamily.value();
+
+    recordCommandPools.resize(MAX_FRAMES_IN_FLIGHT * threadCount);
+    for (VkCommandPool& pool : recordCommandPools) {
+        VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &pool);
+        if (result != VK_SUCCESS) {
+            std::cerr << string_VkResult(result) << std::endl;
+            throw std::runtime_error("[VULKAN] Failed to create recording CommandPool");
+        }
+    }
+    std::cout << "[VULKAN] Recording draws on " << threadCount << " threads" << std::endl;
 }
 
 void Swiftcanon::createDepthResources()
 {
-    VkFormat depthFormat =  findSupportedFormat(
+    depthFormat = findSupportedFormat(
         {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
         VK_IMAGE_TILING_OPTIMAL,
         VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
@@ -744,7 +1175,8 @@ void Swiftcanon::createDepthResources()
         swapChainExtent.height,
         depthFormat,
         VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        // Sampled by the Hi-Z pyramid build
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         depthImage,
         depthImageMemory
@@ -759,22 +1191,9 @@ void Swiftcanon::createDepthResources()
 
 void Swiftcanon::createVertexBuffer()
 {
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(
-        bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer,
-        stagingBufferMemory
-    );
-
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, vertices.data(), (size_t) bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
+    CpuProfileScope scope("createVertexBuffer");
+    size_t vertexCount = mesh.sectionCount(MESH_SECTION_VERTICES);
+    VkDeviceSize bufferSize = vertexCount * vertexLayout.stride;
 
     createBuffer(
         bufferSize,
@@ -784,41 +1203,32 @@ void Swiftcanon::createVertexBuffer()
         vertexBufferMemory
     );
 
-    copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    // Packed straight into the staging ring, in chunks so meshes larger than the ring still upload
+    const Vertex* vertices = static_cast<const Vertex*>(mesh.sectionData(MESH_SECTION_VERTICES));
+    size_t chunkVertices = static_cast<size_t>(stagingRing.capacity() / 2 / vertexLayout.stride);
+    for (size_t first = 0; first < vertexCount; first += chunkVertices) {
+        size_t count = std::min(chunkVertices, vertexCount - first);
+        void* data = stagingRing.stage(vertexBuffer, first * vertexLayout.stride, count * vertexLayout.stride);
+        packVertices(vertexLayout.format, vertices + first, count, mesh.bounds(), data);
+    }
 }
 
 void Swiftcanon::createIndexBuffer()
 {
-    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(
-        bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer, stagingBufferMemory
-    );
-
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, indices.data(), (size_t) bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
+    CpuProfileScope scope("createIndexBuffer");
+    // cull.comp reads 16-bit indices as 32-bit words, round up so the last word stays in bounds
+    VkDeviceSize indexDataSize = mesh.sectionSize(MESH_SECTION_INDICES);
+    VkDeviceSize bufferSize = (indexDataSize + 3) / 4 * 4;
 
     createBuffer(
         bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         indexBuffer,
         indexBufferMemory
     );
 
-    copyBuffer(stagingBuffer, indexBuffer, bufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    stagingRing.upload(indexBuffer, 0, mesh.sectionData(MESH_SECTION_INDICES), indexDataSize);
 }
 
 void Swiftcanon::createUniformBuffers() {
@@ -836,28 +1246,39 @@ void Swiftcanon::createUniformBuffers() {
             uniformBuffers[i],
             uniformBuffersMemory[i]
         );
-        vkMapMemory(
-            device,
-            uniformBuffersMemory[i],
-            0,
-            bufferSize,
-            0,
-            &uniformBuffersMapped[i]
+        uniformBuffersMapped[i] = uniformBuffersMemory[i].mapped;
+    }
+
+    cullCameraBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    cullCameraBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        createBuffer(
+            sizeof(CullCamera),
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            cullCameraBuffers[i],
+            cullCameraBuffersMemory[i]
         );
     }
 }
 
 void Swiftcanon::createDescriptorPool()
 {
-    VkDescriptorPoolSize poolSize{};
-    poolSize.type               = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount    = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    // Per frame: the uniform buffer, meshlet culling with 4 storage buffers and the cull camera,
+    // 2 instance cull sets of 5 storage buffers, the Hi-Z pyramid and the cull camera
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0].type               = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount    = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 4;
+    poolSizes[1].type               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount    = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 14;
+    poolSizes[2].type               = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[2].descriptorCount    = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2;
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount  = 1;
-    poolInfo.pPoolSizes     = &poolSize;
-    poolInfo.maxSets        = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolInfo.poolSizeCount  = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes     = poolSizes.data();
+    poolInfo.maxSets        = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 4;
     
     VkResult result = vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool);
     if (result != VK_SUCCESS) {
@@ -868,6 +1289,7 @@ void Swiftcanon::createDescriptorPool()
 
 void Swiftcanon::createDescriptorSets()
 {
+    CpuProfileScope scope("createDescriptorSets");
     std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType                 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -901,62 +1323,797 @@ void Swiftcanon::createDescriptorSets()
 
         vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
     }
-}
 
-// TODO: Massively improve scoring factors to better score the GPUs
-void Swiftcanon::ratePhysicalGraphicsDevices(VkPhysicalDevice device, int deviceIndex)
-{
-    VkPhysicalDeviceFeatures deviceFeatures;
-    VkPhysicalDeviceProperties deviceProperties;
-    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
-    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (indirectDrawMode != INDIRECT_DRAW_NONE) {
+        std::vector<VkDescriptorSetLayout> instanceCullLayouts(MAX_FRAMES_IN_FLIGHT * 2, instanceCullDescriptorSetLayout);
+        VkDescriptorSetAllocateInfo instanceCullAllocInfo = allocInfo;
+        instanceCullAllocInfo.descriptorSetCount    = static_cast<uint32_t>(instanceCullLayouts.size());
+        instanceCullAllocInfo.pSetLayouts           = instanceCullLayouts.data();
 
-    uint32_t deviceExtensionCount;
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &deviceExtensionCount, nullptr);
-    std::vector<VkExtensionProperties> availableDeviceExtensions(deviceExtensionCount);
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &deviceExtensionCount, availableDeviceExtensions.data());
+        instanceCullDescriptorSets.resize(instanceCullLayouts.size());
+        result = vkAllocateDescriptorSets(device, &instanceCullAllocInfo, instanceCullDescriptorSets.data());
+        if (result != VK_SUCCESS) {
+            std::cerr << string_VkResult(result) << std::endl;
+            throw std::runtime_error("[VULKAN] Failed to allocate Instance Cull DescriptorSets");
+        }
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            writeInstanceCullDescriptorSet(static_cast<uint32_t>(i));
+        }
+    }
 
-    uint32_t queueFamilyCount = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+    if (!options.clusterCulling) {
+        return;
+    }
 
-    DeviceDetails deviceDetails;
-    std::string* string = new std::string(deviceProperties.deviceName);
-    deviceDetails.name = string->c_str();
-    deviceDetails.score = 0;
-    deviceDetails.deviceIndex = deviceIndex;
-    deviceDetails.extensionCount = deviceExtensionCount;
+    std::vector<VkDescriptorSetLayout> cullLayouts(MAX_FRAMES_IN_FLIGHT, cullDescriptorSetLayout);
+    allocInfo.pSetLayouts           = cullLayouts.data();
 
-    // Discrete GPUs have a significant performance advantage
-    if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
-        deviceDetails.score += 1000;
+    cullDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+    result = vkAllocateDescriptorSets(device, &allocInfo, cullDescriptorSets.data());
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to allocate Cull DescriptorSets");
     }
-    // Maximum possible size of textures affects graphics quality
-    deviceDetails.score += deviceProperties.limits.maxImageDimension2D;
 
-    // Check if device supports required extensions
-    int supportedExtensions = 0;
-    for (const char* requiredDeviceExtension : requiredDeviceExtensions) {
-        for (VkExtensionProperties extension : availableDeviceExtensions) {
-            if (strcmp(requiredDeviceExtension, extension.extensionName) == 0) {
-                supportedExtensions++;
-                continue;
-            }
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        std::array<VkDescriptorBufferInfo, 5> bufferInfos{};
+        bufferInfos[0].buffer   = meshletBuffer;
+        bufferInfos[1].buffer   = indexBuffer;
+        bufferInfos[2].buffer   = culledIndexBuffers[i];
+        bufferInfos[3].buffer   = drawIndirectBuffers[i];
+        bufferInfos[4].buffer   = cullCameraBuffers[i];
+
+        std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+            bufferInfos[binding].offset             = 0;
+            bufferInfos[binding].range              = VK_WHOLE_SIZE;
+            descriptorWrites[binding].sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet            = cullDescriptorSets[i];
+            descriptorWrites[binding].dstBinding        = binding;
+            descriptorWrites[binding].dstArrayElement   = 0;
+            descriptorWrites[binding].descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[binding].descriptorCount   = 1;
+            descriptorWrites[binding].pBufferInfo       = &bufferInfos[binding];
         }
+        descriptorWrites[4].descriptorType              = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
     }
-    if (supportedExtensions != requiredDeviceExtensions.size()) {
-        deviceDetails.score = 0;
-        std::cout << "[VULKAN] WARNING: Physical Device " << deviceDetails.name << " does not support required Vulkan Extensions, setting score to 0" << std::endl;
+}
+
+void Swiftcanon::createCullPipeline()
+{
+    if (!options.clusterCulling) {
+        return;
     }
-    
-    // Check if device supports required queues
-    VkBool32 presentSupport;
-    QueueFamilyIndices deviceIndices;
-    for (uint32_t i = 0; i < queueFamilies.size(); i++) {
-        presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-        if(presentSupport && (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)){
+
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+    for (uint32_t binding = 0; binding < bindings.size(); binding++) {
+        bindings[binding].binding           = binding;
+        bindings[binding].descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[binding].descriptorCount   = 1;
+        bindings[binding].stageFlags        = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[4].descriptorType              = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings    = bindings.data();
+
+    VkResult result = vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &cullDescriptorSetLayout);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to create Cull Descriptor Set Layout");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags    = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset        = 0;
+    pushConstantRange.size          = sizeof(CullPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount           = 1;
+    pipelineLayoutInfo.pSetLayouts              = &cullDescriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount   = 1;
+    pipelineLayoutInfo.pPushConstantRanges      = &pushConstantRange;
+
+    result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to create Cull Pipeline Layout");
+    }
+
+    cullPipeline = compileComputePipeline("cluster cull", SPIRV_CULL_COMP, sizeof(SPIRV_CULL_COMP), cullPipelineLayout);
+}
+
+void Swiftcanon::createCullBuffers()
+{
+    CpuProfileScope scope("createCullBuffers");
+    if (!options.clusterCulling) {
+        return;
+    }
+
+    VkDeviceSize meshletBufferSize = mesh.sectionSize(MESH_SECTION_MESHLETS);
+
+    createBuffer(
+        meshletBufferSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        meshletBuffer,
+        meshletBufferMemory
+    );
+
+    stagingRing.upload(meshletBuffer, 0, mesh.sectionData(MESH_SECTION_MESHLETS), meshletBufferSize);
+
+    // Written by the cull pass every frame, one set per frame in flight
+    culledIndexBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    culledIndexBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    drawIndirectBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    drawIndirectBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    // LOD 0 has the most indices, so the buffer fits whichever LOD is selected
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        createBuffer(
+            mesh.lods()[0].indexCount * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            culledIndexBuffers[i],
+            culledIndexBuffersMemory[i]
+        );
+        createBuffer(
+            sizeof(VkDrawIndexedIndirectCommand),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            drawIndirectBuffers[i],
+            drawIndirectBuffersMemory[i]
+        );
+    }
+}
+
+// Gribb-Hartmann plane extraction from a clip matrix, Vulkan clip space has 0 <= z <= w
+static void extractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6])
+{
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+    }
+    planes[0] = rows[3] + rows[0];  // Left
+    planes[1] = rows[3] - rows[0];  // Right
+    planes[2] = rows[3] + rows[1];  // Bottom
+    planes[3] = rows[3] - rows[1];  // Top
+    planes[4] = rows[2];            // Near
+    planes[5] = rows[3] - rows[2];  // Far
+    for (int i = 0; i < 6; i++) {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+}
+
+void Swiftcanon::recordCullPass(VkCommandBuffer command_buffer)
+{
+    // The camera comes from cullCameraBuffers, see updateCullCamera
+    CullPushConstants constants{};
+    constants.firstMeshlet      = mesh.lods()[currentLod].firstMeshlet;
+    constants.meshletCount      = mesh.lods()[currentLod].meshletCount;
+    constants.indexStride       = mesh.indexStride();
+
+    VkDrawIndexedIndirectCommand drawCommand{};
+    drawCommand.indexCount      = 0;
+    drawCommand.instanceCount   = 1;
+    drawCommand.firstIndex      = 0;
+    drawCommand.vertexOffset    = 0;
+    drawCommand.firstInstance   = 0;
+    vkCmdUpdateBuffer(command_buffer, drawIndirectBuffers[currentFrame], 0, sizeof(drawCommand), &drawCommand);
+
+    VkBufferMemoryBarrier resetBarrier{};
+    resetBarrier.sType                  = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    resetBarrier.srcAccessMask          = VK_ACCESS_TRANSFER_WRITE_BIT;
+    resetBarrier.dstAccessMask          = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    resetBarrier.srcQueueFamilyIndex    = VK_QUEUE_FAMILY_IGNORED;
+    resetBarrier.dstQueueFamilyIndex    = VK_QUEUE_FAMILY_IGNORED;
+    resetBarrier.buffer                 = drawIndirectBuffers[currentFrame];
+    resetBarrier.offset                 = 0;
+    resetBarrier.size                   = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &resetBarrier, 0, nullptr);
+
+    // One workgroup per meshlet, wrapped into y past the minimum guaranteed dispatch width
+    const uint32_t maxGroupsX = 65535;
+    uint32_t groupsX = std::min(constants.meshletCount, maxGroupsX);
+    uint32_t groupsY = (constants.meshletCount + maxGroupsX - 1) / maxGroupsX;
+    vkCmdBindPipeline           (command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineManager.get(cullPipeline));
+    vkCmdBindDescriptorSets     (command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullDescriptorSets[currentFrame], 0, nullptr);
+    vkCmdPushConstants          (command_buffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch               (command_buffer, groupsX, groupsY, 1);
+
+    std::array<VkBufferMemoryBarrier, 2> cullBarriers{};
+    for (VkBufferMemoryBarrier& barrier : cullBarriers) {
+        barrier.sType                   = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask           = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.srcQueueFamilyIndex     = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex     = VK_QUEUE_FAMILY_IGNORED;
+        barrier.offset                  = 0;
+        barrier.size                    = VK_WHOLE_SIZE;
+    }
+    cullBarriers[0].dstAccessMask       = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    cullBarriers[0].buffer              = drawIndirectBuffers[currentFrame];
+    cullBarriers[1].dstAccessMask       = VK_ACCESS_INDEX_READ_BIT;
+    cullBarriers[1].buffer              = culledIndexBuffers[currentFrame];
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        0, 0, nullptr,
+        static_cast<uint32_t>(cullBarriers.size()), cullBarriers.data(),
+        0, nullptr
+    );
+}
+
+void Swiftcanon::createInstanceCullPipeline()
+{
+    if (indirectDrawMode == INDIRECT_DRAW_NONE) {
+        return;
+    }
+
+    // Instances, sub-meshes, draws, visibility and stats, then the Hi-Z pyramid and the camera
+    std::array<VkDescriptorSetLayoutBinding, 7> bindings{};
+    for (uint32_t binding = 0; binding < bindings.size(); binding++) {
+        bindings[binding].binding           = binding;
+        bindings[binding].descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[binding].descriptorCount   = 1;
+        bindings[binding].stageFlags        = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[5].descriptorType              = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[6].descriptorType              = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings    = bindings.data();
+
+    VkResult result = vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &instanceCullDescriptorSetLayout);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to create Instance Cull Descriptor Set Layout");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags    = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset        = 0;
+    pushConstantRange.size          = sizeof(InstanceCullPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount           = 1;
+    pipelineLayoutInfo.pSetLayouts              = &instanceCullDescriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount   = 1;
+    pipelineLayoutInfo.pPushConstantRanges      = &pushConstantRange;
+
+    result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &instanceCullPipelineLayout);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to create Instance Cull Pipeline Layout");
+    }
+
+    instanceCullPipeline = compileComputePipeline("instance cull", SPIRV_INSTANCE_CULL_COMP, sizeof(SPIRV_INSTANCE_CULL_COMP), instanceCullPipelineLayout);
+}
+
+void Swiftcanon::createInstanceCullBuffers()
+{
+    CpuProfileScope scope("createInstanceCullBuffers");
+    if (indirectDrawMode == INDIRECT_DRAW_NONE) {
+        return;
+    }
+
+    // Sub-meshes of every LOD, the cull pass reads the range of the selected one
+    VkDeviceSize subMeshBufferSize = mesh.sectionSize(MESH_SECTION_SUBMESHES);
+
+    createBuffer(
+        subMeshBufferSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        subMeshBuffer,
+        subMeshBufferMemory
+    );
+
+    stagingRing.upload(subMeshBuffer, 0, mesh.sectionData(MESH_SECTION_SUBMESHES), subMeshBufferSize);
+
+    // Read back by collectCullStats once the frame's fence has signalled
+    cullStatsBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    cullStatsBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        createBuffer(
+            sizeof(CullStats),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            cullStatsBuffers[i],
+            cullStatsBuffersMemory[i],
+            VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+        );
+        memset(cullStatsBuffersMemory[i].mapped, 0, sizeof(CullStats));
+    }
+}
+
+void Swiftcanon::writeInstanceCullDescriptorSet(uint32_t frame)
+{
+    commandBufferEpoch++;
+    VkBuffer drawBuffers[] = { instanceDrawBuffers[frame], instanceLateDrawBuffers[frame] };
+    for (uint32_t set = 0; set < 2; set++) {
+        std::array<VkDescriptorBufferInfo, 5> bufferInfos{};
+        bufferInfos[0].buffer   = instanceBuffers[frame];
+        bufferInfos[1].buffer   = subMeshBuffer;
+        bufferInfos[2].buffer   = drawBuffers[set];
+        bufferInfos[3].buffer   = instanceVisibilityBuffer;
+        bufferInfos[4].buffer   = cullStatsBuffers[frame];
+
+        VkDescriptorBufferInfo cameraInfo{};
+        cameraInfo.buffer       = cullCameraBuffers[frame];
+        cameraInfo.offset       = 0;
+        cameraInfo.range        = sizeof(CullCamera);
+
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.sampler       = hiZSampler;
+        imageInfo.imageView     = hiZImageView;
+        imageInfo.imageLayout   = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 7> descriptorWrites{};
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+            descriptorWrites[binding].sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet            = instanceCullDescriptorSets[frame * 2 + set];
+            descriptorWrites[binding].dstBinding        = binding;
+            descriptorWrites[binding].dstArrayElement   = 0;
+            descriptorWrites[binding].descriptorCount   = 1;
+            if (binding < bufferInfos.size()) {
+                bufferInfos[binding].offset             = 0;
+                bufferInfos[binding].range              = VK_WHOLE_SIZE;
+                descriptorWrites[binding].descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorWrites[binding].pBufferInfo       = &bufferInfos[binding];
+            }
+        }
+        descriptorWrites[5].descriptorType      = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[5].pImageInfo          = &imageInfo;
+        descriptorWrites[6].descriptorType      = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[6].pBufferInfo         = &cameraInfo;
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void Swiftcanon::recordInstanceCullPass(VkCommandBuffer command_buffer, InstanceCullPass pass)
+{
+    // The camera comes from cullCameraBuffers, see updateCullCamera
+    const MeshLod& lod = mesh.lods()[currentLod];
+    InstanceCullPushConstants constants{};
+    constants.firstSubMesh      = lod.firstSubMesh;
+    constants.subMeshCount      = lod.subMeshCount;
+    constants.instanceCount     = instances.count();
+    constants.compact           = indirectDrawMode == INDIRECT_DRAW_COUNT ? 1 : 0;
+    constants.pass              = pass;
+
+    // Counters of both passes are reset up front, the late pass only adds to them
+    if (pass != INSTANCE_CULL_LATE) {
+        vkCmdFillBuffer(command_buffer, instanceDrawBuffers[currentFrame], 0, sizeof(uint32_t), 0);
+        vkCmdFillBuffer(command_buffer, instanceLateDrawBuffers[currentFrame], 0, sizeof(uint32_t), 0);
+        vkCmdFillBuffer(command_buffer, cullStatsBuffers[currentFrame], 0, sizeof(CullStats), 0);
+
+        // Also orders this frame's visibility reads after the previous frame's late pass
+        VkMemoryBarrier resetBarrier{};
+        resetBarrier.sType          = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        resetBarrier.srcAccessMask  = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        resetBarrier.dstAccessMask  = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &resetBarrier, 0, nullptr, 0, nullptr
+        );
+    }
+
+    // One invocation per instance, 64 per workgroup
+    uint32_t descriptorSet = currentFrame * 2 + (pass == INSTANCE_CULL_LATE ? 1 : 0);
+    vkCmdBindPipeline           (command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineManager.get(instanceCullPipeline));
+    vkCmdBindDescriptorSets     (command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, instanceCullPipelineLayout, 0, 1, &instanceCullDescriptorSets[descriptorSet], 0, nullptr);
+    vkCmdPushConstants          (command_buffer, instanceCullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch               (command_buffer, (constants.instanceCount + 63) / 64, 1, 1);
+
+    // Draws are read as indirect commands, the stats by the host after the frame's fence
+    VkMemoryBarrier cullBarrier{};
+    cullBarrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullBarrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    cullBarrier.dstAccessMask   = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &cullBarrier, 0, nullptr, 0, nullptr
+    );
+}
+
+void Swiftcanon::recordInstanceDraws(VkCommandBuffer command_buffer, VkBuffer drawBuffer, uint32_t maxDrawCount)
+{
+    vkCmdBindIndexBuffer    (command_buffer, indexBuffer, 0, mesh.indexStride() == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+    if (indirectDrawMode == INDIRECT_DRAW_COUNT) {
+        vkCmdDrawIndexedIndirectCount(command_buffer, drawBuffer, INSTANCE_DRAW_COMMANDS_OFFSET, drawBuffer, 0, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+    }
+    else {
+        vkCmdDrawIndexedIndirect(command_buffer, drawBuffer, INSTANCE_DRAW_COMMANDS_OFFSET, maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
+void Swiftcanon::createHiZPipeline()
+{
+    if (indirectDrawMode == INDIRECT_DRAW_NONE) {
+        return;
+    }
+
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding             = 0;
+    bindings[0].descriptorType      = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount     = 1;
+    bindings[0].stageFlags          = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding             = 1;
+    bindings[1].descriptorType      = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount     = 1;
+    bindings[1].stageFlags          = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings    = bindings.data();
+
+    VkResult result = vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &hiZDescriptorSetLayout);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to create Hi-Z Descriptor Set Layout");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags    = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset        = 0;
+    pushConstantRange.size          = sizeof(HiZPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount           = 1;
+    pipelineLayoutInfo.pSetLayouts              = &hiZDescriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount   = 1;
+    pipelineLayoutInfo.pPushConstantRanges      = &pushConstantRange;
+
+    result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &hiZPipelineLayout);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to create Hi-Z Pipeline Layout");
+    }
+
+    hiZPipeline = compileComputePipeline("Hi-Z build", SPIRV_HIZ_BUILD_COMP, sizeof(SPIRV_HIZ_BUILD_COMP), hiZPipelineLayout);
+
+    // Both shaders only use texelFetch, the sampler exists because sampled descriptors need one
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType           = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter       = VK_FILTER_NEAREST;
+    samplerInfo.minFilter       = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode      = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU    = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV    = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW    = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod          = 0.0f;
+    samplerInfo.maxLod          = VK_LOD_CLAMP_NONE;
+
+    result = vkCreateSampler(device, &samplerInfo, nullptr, &hiZSampler);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to create Hi-Z Sampler");
+    }
+}
+
+static uint32_t previousPowerOfTwo(uint32_t value)
+{
+    uint32_t result = 1;
+    while (result * 2 <= value) {
+        result *= 2;
+    }
+    return result;
+}
+
+void Swiftcanon::createHiZResources()
+{
+    CpuProfileScope scope("createHiZResources");
+    if (indirectDrawMode == INDIRECT_DRAW_NONE) {
+        return;
+    }
+
+    // Rounding down keeps every level an exact 2x2 reduction of the one above, only level 0 reads an uneven footprint
+    hiZExtent.width     = previousPowerOfTwo(swapChainExtent.width);
+    hiZExtent.height    = previousPowerOfTwo(swapChainExtent.height);
+    hiZMipLevels = 1;
+    while ((std::max(hiZExtent.width, hiZExtent.height) >> hiZMipLevels) > 0) {
+        hiZMipLevels++;
+    }
+
+    createImage(
+        hiZExtent.width,
+        hiZExtent.height,
+        VK_FORMAT_R32_SFLOAT,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        hiZImage,
+        hiZImageMemory,
+        hiZMipLevels
+    );
+    hiZImageView = createImageView(hiZImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, hiZMipLevels);
+    hiZMipViews.resize(hiZMipLevels);
+    for (uint32_t i = 0; i < hiZMipLevels; i++) {
+        hiZMipViews[i] = createImageView(hiZImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, i, 1);
+    }
+
+    // One set per level, the level count changes with the window size so the pool lives with the pyramid
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type               = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount    = hiZMipLevels;
+    poolSizes[1].type               = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount    = hiZMipLevels;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount  = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes     = poolSizes.data();
+    poolInfo.maxSets        = hiZMipLevels;
+
+    VkResult result = vkCreateDescriptorPool(device, &poolInfo, nullptr, &hiZDescriptorPool);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to create Hi-Z DescriptorPool");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(hiZMipLevels, hiZDescriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType                 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool        = hiZDescriptorPool;
+    allocInfo.descriptorSetCount    = hiZMipLevels;
+    allocInfo.pSetLayouts           = layouts.data();
+
+    hiZDescriptorSets.resize(hiZMipLevels);
+    result = vkAllocateDescriptorSets(device, &allocInfo, hiZDescriptorSets.data());
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to allocate Hi-Z DescriptorSets");
+    }
+
+    for (uint32_t i = 0; i < hiZMipLevels; i++) {
+        // Level 0 reduces the depth buffer, every other level the one before it
+        VkDescriptorImageInfo sourceInfo{};
+        sourceInfo.sampler          = hiZSampler;
+        sourceInfo.imageView        = i == 0 ? depthImageView : hiZMipViews[i - 1];
+        sourceInfo.imageLayout      = i == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+        VkDescriptorImageInfo destinationInfo{};
+        destinationInfo.imageView   = hiZMipViews[i];
+        destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+            descriptorWrites[binding].sType             = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet            = hiZDescriptorSets[i];
+            descriptorWrites[binding].dstBinding        = binding;
+            descriptorWrites[binding].dstArrayElement   = 0;
+            descriptorWrites[binding].descriptorCount   = 1;
+        }
+        descriptorWrites[0].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[0].pImageInfo      = &sourceInfo;
+        descriptorWrites[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descriptorWrites[1].pImageInfo      = &destinationInfo;
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    // After a resize the instance cull sets still point at the old pyramid. The other frame may still be using its
+    // set, so every frame rewrites its own once its fence has signalled, see drawFrame.
+    if (!instanceCullDescriptorSets.empty()) {
+        instanceCullSetsStale.assign(MAX_FRAMES_IN_FLIGHT, true);
+    }
+}
+
+void Swiftcanon::cleanupHiZResources()
+{
+    if (hiZImage == VK_NULL_HANDLE) {
+        return;
+    }
+    deferDeletion([this, descriptorPool = hiZDescriptorPool, mipViews = hiZMipViews, imageView = hiZImageView,
+                   image = hiZImage, imageMemory = hiZImageMemory]() mutable {
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        for (VkImageView view : mipViews) {
+            vkDestroyImageView(device, view, nullptr);
+        }
+        vkDestroyImageView(device, imageView, nullptr);
+        vkDestroyImage(device, image, nullptr);
+        memoryAllocator.free(imageMemory);
+    });
+    hiZImage = VK_NULL_HANDLE;
+}
+
+void Swiftcanon::recordHiZBuild(VkCommandBuffer command_buffer)
+{
+    VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT) {
+        depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+
+    // Depth written by the early pass becomes readable, the pyramid's old contents are discarded once the
+    // previous frame's late cull pass is done with them
+    std::array<VkImageMemoryBarrier, 2> beginBarriers{};
+    for (VkImageMemoryBarrier& barrier : beginBarriers) {
+        barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.baseMipLevel   = 0;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount     = 1;
+    }
+    beginBarriers[0].srcAccessMask                  = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    beginBarriers[0].dstAccessMask                  = VK_ACCESS_SHADER_READ_BIT;
+    beginBarriers[0].oldLayout                      = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    beginBarriers[0].newLayout                      = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    beginBarriers[0].image                          = depthImage;
+    beginBarriers[0].subresourceRange.aspectMask    = depthAspect;
+    beginBarriers[0].subresourceRange.levelCount    = 1;
+    beginBarriers[1].srcAccessMask                  = 0;
+    beginBarriers[1].dstAccessMask                  = VK_ACCESS_SHADER_WRITE_BIT;
+    beginBarriers[1].oldLayout                      = VK_IMAGE_LAYOUT_UNDEFINED;
+    beginBarriers[1].newLayout                      = VK_IMAGE_LAYOUT_GENERAL;
+    beginBarriers[1].image                          = hiZImage;
+    beginBarriers[1].subresourceRange.aspectMask    = VK_IMAGE_ASPECT_COLOR_BIT;
+    beginBarriers[1].subresourceRange.levelCount    = hiZMipLevels;
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, nullptr, 0, nullptr,
+        static_cast<uint32_t>(beginBarriers.size()), beginBarriers.data()
+    );
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineManager.get(hiZPipeline));
+    uint32_t sourceWidth = swapChainExtent.width;
+    uint32_t sourceHeight = swapChainExtent.height;
+    for (uint32_t i = 0; i < hiZMipLevels; i++) {
+        HiZPushConstants constants{};
+        constants.sourceSize[0]         = sourceWidth;
+        constants.sourceSize[1]         = sourceHeight;
+        constants.destinationSize[0]    = std::max(hiZExtent.width >> i, 1u);
+        constants.destinationSize[1]    = std::max(hiZExtent.height >> i, 1u);
+
+        vkCmdBindDescriptorSets (command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, hiZPipelineLayout, 0, 1, &hiZDescriptorSets[i], 0, nullptr);
+        vkCmdPushConstants      (command_buffer, hiZPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch           (command_buffer, (constants.destinationSize[0] + 7) / 8, (constants.destinationSize[1] + 7) / 8, 1);
+
+        // The next level and the late cull pass read this one
+        VkImageMemoryBarrier levelBarrier{};
+        levelBarrier.sType                              = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        levelBarrier.srcAccessMask                      = VK_ACCESS_SHADER_WRITE_BIT;
+        levelBarrier.dstAccessMask                      = VK_ACCESS_SHADER_READ_BIT;
+        levelBarrier.oldLayout                          = VK_IMAGE_LAYOUT_GENERAL;
+        levelBarrier.newLayout                          = VK_IMAGE_LAYOUT_GENERAL;
+        levelBarrier.srcQueueFamilyIndex                = VK_QUEUE_FAMILY_IGNORED;
+        levelBarrier.dstQueueFamilyIndex                = VK_QUEUE_FAMILY_IGNORED;
+        levelBarrier.image                              = hiZImage;
+        levelBarrier.subresourceRange.aspectMask        = VK_IMAGE_ASPECT_COLOR_BIT;
+        levelBarrier.subresourceRange.baseMipLevel      = i;
+        levelBarrier.subresourceRange.levelCount        = 1;
+        levelBarrier.subresourceRange.baseArrayLayer    = 0;
+        levelBarrier.subresourceRange.layerCount        = 1;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+
+        sourceWidth = constants.destinationSize[0];
+        sourceHeight = constants.destinationSize[1];
+    }
+
+    // The late render pass loads the depth again
+    VkImageMemoryBarrier depthBarrier = beginBarriers[0];
+    depthBarrier.srcAccessMask  = 0;
+    depthBarrier.dstAccessMask  = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    depthBarrier.oldLayout      = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    depthBarrier.newLayout      = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &depthBarrier
+    );
+}
+
+void Swiftcanon::collectCullStats(uint32_t frame)
+{
+    if (indirectDrawMode == INDIRECT_DRAW_NONE) {
+        return;
+    }
+
+    // The frame's fence has signalled, so these are the counts of the last frame recorded into this slot
+    memcpy(&lastCullStats, cullStatsBuffersMemory[frame].mapped, sizeof(CullStats));
+    cullStatsTotal.frustumCulled    += lastCullStats.frustumCulled;
+    cullStatsTotal.occlusionCulled  += lastCullStats.occlusionCulled;
+    cullStatsTotal.drawnEarly       += lastCullStats.drawnEarly;
+    cullStatsTotal.drawnLate        += lastCullStats.drawnLate;
+    cullStatsFrames++;
+
+    double now = elapsedTime();
+    if (now - cullStatsStartTime >= 1.0) {
+        std::cout << "[CULL] " << instances.count() << " instances, per frame: "
+                  << cullStatsTotal.frustumCulled / cullStatsFrames << " outside the frustum, "
+                  << cullStatsTotal.occlusionCulled / cullStatsFrames << " occluded, "
+                  << (cullStatsTotal.drawnEarly + cullStatsTotal.drawnLate) / cullStatsFrames << " drawn ("
+                  << cullStatsTotal.drawnEarly / cullStatsFrames << " early, "
+                  << cullStatsTotal.drawnLate / cullStatsFrames << " late)" << std::endl;
+        cullStatsTotal = CullStats{};
+        cullStatsFrames = 0;
+        cullStatsStartTime = now;
+    }
+}
+
+// TODO: Massively improve scoring factors to better score the GPUs
+void Swiftcanon::ratePhysicalGraphicsDevices(VkPhysicalDevice device, int deviceIndex)
+{
+    VkPhysicalDeviceFeatures deviceFeatures;
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+    uint32_t deviceExtensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &deviceExtensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableDeviceExtensions(deviceExtensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &deviceExtensionCount, availableDeviceExtensions.data());
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+    DeviceDetails deviceDetails;
+    std::string* string = new std::string(deviceProperties.deviceName);
+    deviceDetails.name = string->c_str();
+    deviceDetails.score = 0;
+    deviceDetails.deviceIndex = deviceIndex;
+    deviceDetails.extensionCount = deviceExtensionCount;
+    deviceDetails.multiDrawIndirect = deviceFeatures.multiDrawIndirect == VK_TRUE;
+    deviceDetails.drawIndirectFirstInstance = deviceFeatures.drawIndirectFirstInstance == VK_TRUE;
+    deviceDetails.maxDrawIndirectCount = deviceProperties.limits.maxDrawIndirectCount;
+    deviceDetails.timestampPeriod = deviceProperties.limits.timestampPeriod;
+    deviceDetails.timestampValidBits = 0;
+    deviceDetails.pipelineStatisticsQuery = deviceFeatures.pipelineStatisticsQuery == VK_TRUE;
+    deviceDetails.inheritedQueries = deviceFeatures.inheritedQueries == VK_TRUE;
+
+    // Discrete GPUs have a significant performance advantage
+    if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
+        deviceDetails.score += 1000;
+    }
+    // Maximum possible size of textures affects graphics quality
+    deviceDetails.score += deviceProperties.limits.maxImageDimension2D;
+
+    // Check if device supports required extensions
+    int supportedExtensions = 0;
+    for (const char* requiredDeviceExtension : requiredDeviceExtensions) {
+        for (VkExtensionProperties extension : availableDeviceExtensions) {
+            if (strcmp(requiredDeviceExtension, extension.extensionName) == 0) {
+                supportedExtensions++;
+                continue;
+            }
+        }
+    }
+    if (supportedExtensions != requiredDeviceExtensions.size()) {
+        deviceDetails.score = 0;
+        std::cout << "[VULKAN] WARNING: Physical Device " << deviceDetails.name << " does not support required Vulkan Extensions, setting score to 0" << std::endl;
+    }
+    
+    // Check if device supports required queues
+    VkBool32 presentSupport;
+    QueueFamilyIndices deviceIndices;
+    for (uint32_t i = 0; i < queueFamilies.size(); i++) {
+        // Without a surface devices are judged on graphics alone, the graphics family stands in for presentation
+        presentSupport = options.headless;
+        if (!options.headless) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        }
+        // Cluster culling runs its compute pass on the graphics queue
+        bool graphicsSupport = (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT);
+        if(presentSupport && graphicsSupport){
             deviceIndices.presentFamily = i;
             deviceIndices.graphicsFamily = i;
             break;
@@ -965,11 +2122,47 @@ void Swiftcanon::ratePhysicalGraphicsDevices(VkPhysicalDevice device, int device
             if (presentSupport) {
                 deviceIndices.presentFamily = i;
             }
-            if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            if (graphicsSupport) {
                 deviceIndices.graphicsFamily = i;
             }
         }
     }
+
+    if (deviceIndices.graphicsFamily.has_value()) {
+        deviceDetails.timestampValidBits = queueFamilies[deviceIndices.graphicsFamily.value()].timestampValidBits;
+    }
+
+    // A transfer queue is only used with timeline semaphores to hand the copies over to the graphics queue
+    deviceDetails.timelineSemaphores = false;
+    deviceDetails.drawIndirectCount = false;
+    // The instance has to be 1.2 as well, the 1.2 feature query and structs aren't usable through a 1.0 instance
+    if (instanceApiVersion >= VK_API_VERSION_1_2
+        && (VK_API_VERSION_MAJOR(deviceProperties.apiVersion) > 1 || VK_API_VERSION_MINOR(deviceProperties.apiVersion) >= 2)) {
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &vulkan12Features;
+        vkGetPhysicalDeviceFeatures2(device, &features2);
+        deviceDetails.timelineSemaphores = vulkan12Features.timelineSemaphore == VK_TRUE;
+        deviceDetails.drawIndirectCount = vulkan12Features.drawIndirectCount == VK_TRUE;
+    }
+    if (deviceDetails.timelineSemaphores) {
+        for (uint32_t i = 0; i < queueFamilies.size(); i++) {
+            VkQueueFlags flags = queueFamilies[i].queueFlags;
+            if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+                continue;
+            }
+            if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+                deviceIndices.transferFamily = i;
+                break;
+            }
+            if (!deviceIndices.transferFamily.has_value()) {
+                deviceIndices.transferFamily = i;
+            }
+        }
+    }
+
     if(deviceIndices.isComplete() == false){
         deviceDetails.score = 0;
         std::cout << "[VULKAN] WARNING: Physical Device " << deviceDetails.name << " does not have Vulkan Compute and Render capabilities, setting score to 0" << std::endl;
@@ -998,6 +2191,7 @@ void Swiftcanon::ratePhysicalGraphicsDevices(VkPhysicalDevice device, int device
 
 void Swiftcanon::recordCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index)
 {
+    CpuProfileScope scope("recordCommandBuffer");
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType             = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags             = 0;        // Optional
@@ -1015,6 +2209,112 @@ void Swiftcanon::recordCommandBuffer(VkCommandBuffer command_buffer, uint32_t im
     renderPassInfo.clearValueCount      = static_cast<uint32_t>(clearValues.size());;
     renderPassInfo.pClearValues         = clearValues.data();
 
+    VkResult result = vkBeginCommandBuffer(command_buffer, &beginInfo);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to initialize recording CommandBuffer");
+    }
+    if (gpuProfiler.enabled()) {
+        gpuProfiler.resetFrame(command_buffer, currentFrame);
+    }
+    if (statsQueryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(command_buffer, statsQueryPool, currentFrame, 1);
+    }
+    beginGpuRegion(command_buffer, "frame");
+
+    // Falls back to instanced draws for the frames where the draw count passes the device limit, and to plain
+    // draws while a cull pipeline is still compiling. Until the graphics pipeline is ready frames are only cleared.
+    const MeshLod& lod = mesh.lods()[currentLod];
+    uint32_t instanceDrawCount = instances.count() * lod.subMeshCount;
+    boundGraphicsPipeline = selectGraphicsPipeline();
+    bool drawing = boundGraphicsPipeline != VK_NULL_HANDLE;
+    bool clusterCulling = drawing && options.clusterCulling && pipelineManager.get(cullPipeline) != VK_NULL_HANDLE;
+    bool instanceCulling = drawing && indirectDrawMode != INDIRECT_DRAW_NONE && instanceDrawCount <= physicalDeviceDetails.maxDrawIndirectCount
+                           && pipelineManager.get(instanceCullPipeline) != VK_NULL_HANDLE;
+    bool occlusionCulling = instanceCulling && options.occlusionCulling && pipelineManager.get(hiZPipeline) != VK_NULL_HANDLE;
+
+    if (clusterCulling) {
+        beginGpuRegion          (command_buffer, "cluster cull");
+        recordCullPass          (command_buffer);
+        endGpuRegion            (command_buffer, "cluster cull");
+    }
+    else if (instanceCulling) {
+        beginGpuRegion          (command_buffer, "instance cull");
+        recordInstanceCullPass  (command_buffer, occlusionCulling ? INSTANCE_CULL_EARLY : INSTANCE_CULL_SINGLE);
+        endGpuRegion            (command_buffer, "instance cull");
+    }
+
+    if (occlusionCulling) {
+        renderPassInfo.renderPass       = earlyRenderPass;
+    }
+    // GPU driven paths end up as a single draw, only the CPU draw list is worth spreading over threads, and only
+    // once every thread gets RECORD_DRAWS_PER_THREAD of it
+    // Timestamps can't go between the secondaries of a render pass, so "draws" is only measured for inline ones
+    // Secondaries can only run inside the statistics query with inheritedQueries, otherwise the draws go inline
+    uint32_t recordThreads = std::min(recordWorkers->size(), instanceDrawCount / RECORD_DRAWS_PER_THREAD);
+    bool secondaryDraws = drawing && !clusterCulling && !instanceCulling && recordThreads > 1
+                          && (statsQueryPool == VK_NULL_HANDLE || physicalDeviceDetails.inheritedQueries);
+    // Spans both render passes, the compute work in between adds nothing to the requested counters
+    if (statsQueryPool != VK_NULL_HANDLE) {
+        vkCmdBeginQuery         (command_buffer, statsQueryPool, currentFrame, 0);
+    }
+    beginGpuRegion              (command_buffer, "render pass");
+    if (secondaryDraws) {
+        vkCmdBeginRenderPass    (command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        recordSecondaryDraws    (command_buffer, renderPassInfo, currentFrame * static_cast<uint32_t>(swapChainImages.size()) + image_index, recordThreads);
+    }
+    else if (drawing) {
+        vkCmdBeginRenderPass    (command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        beginGpuRegion          (command_buffer, "draws");
+        bindGraphicsState       (command_buffer);
+        if (clusterCulling) {
+            // Culled indices are absolute, the indirect command always has a zero vertexOffset
+            vkCmdBindIndexBuffer    (command_buffer, culledIndexBuffers[currentFrame], 0, VK_INDEX_TYPE_UINT32);
+            vkCmdDrawIndexedIndirect(command_buffer, drawIndirectBuffers[currentFrame], 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+        }
+        else if (instanceCulling) {
+            recordInstanceDraws (command_buffer, instanceDrawBuffers[currentFrame], instanceDrawCount);
+        }
+        else {
+            recordSceneDraws    (command_buffer, 0, instances.count());
+        }
+        endGpuRegion            (command_buffer, "draws");
+    }
+    else {
+        vkCmdBeginRenderPass    (command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
+    vkCmdEndRenderPass          (command_buffer);
+    endGpuRegion                (command_buffer, "render pass");
+
+    // Graphics bindings and dynamic state survive the compute work in between, the late pass only draws
+    if (occlusionCulling) {
+        beginGpuRegion          (command_buffer, "hi-z build");
+        recordHiZBuild          (command_buffer);
+        endGpuRegion            (command_buffer, "hi-z build");
+        beginGpuRegion          (command_buffer, "late instance cull");
+        recordInstanceCullPass  (command_buffer, INSTANCE_CULL_LATE);
+        endGpuRegion            (command_buffer, "late instance cull");
+        renderPassInfo.renderPass       = lateRenderPass;
+        beginGpuRegion          (command_buffer, "late render pass");
+        vkCmdBeginRenderPass    (command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        recordInstanceDraws     (command_buffer, instanceLateDrawBuffers[currentFrame], instanceDrawCount);
+        vkCmdEndRenderPass      (command_buffer);
+        endGpuRegion            (command_buffer, "late render pass");
+    }
+    if (statsQueryPool != VK_NULL_HANDLE) {
+        vkCmdEndQuery           (command_buffer, statsQueryPool, currentFrame);
+    }
+    endGpuRegion                (command_buffer, "frame");
+
+    result = vkEndCommandBuffer (command_buffer);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to record CommandBuffer");
+    }
+}
+
+void Swiftcanon::bindGraphicsState(VkCommandBuffer command_buffer)
+{
     VkViewport viewport{};
     viewport.x          = 0.0f;
     viewport.y          = 0.0f;
@@ -1027,30 +2327,87 @@ void Swiftcanon::recordCommandBuffer(VkCommandBuffer command_buffer, uint32_t im
     scissor.offset      = {0, 0};
     scissor.extent      = swapChainExtent;
 
-    VkResult result = vkBeginCommandBuffer(command_buffer, &beginInfo);
-    if (result != VK_SUCCESS) {
-        std::cerr << string_VkResult(result) << std::endl;
-        throw std::runtime_error("[VULKAN] Failed to initialize recording CommandBuffer");
-    }
-
-    VkBuffer vertexBuffers[] = {vertexBuffer};
-    VkDeviceSize offsets[] = {0};
-    vkCmdBeginRenderPass        (command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline           (command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-    vkCmdBindVertexBuffers      (command_buffer, 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer        (command_buffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    VkBuffer vertexBuffers[] = {vertexBuffer, instanceBuffers[currentFrame]};
+    VkDeviceSize offsets[] = {0, 0};
+    vkCmdBindPipeline           (command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundGraphicsPipeline);
+    vkCmdBindVertexBuffers      (command_buffer, 0, 2, vertexBuffers, offsets);
     vkCmdBindDescriptorSets     (command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
     vkCmdSetViewport            (command_buffer, 0, 1, &viewport);
     vkCmdSetScissor             (command_buffer, 0, 1, &scissor);
-    vkCmdDrawIndexed            (command_buffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-    vkCmdEndRenderPass          (command_buffer);
-    result = vkEndCommandBuffer (command_buffer);
-    if (result != VK_SUCCESS) {
-        std::cerr << string_VkResult(result) << std::endl;
-        throw std::runtime_error("[VULKAN] Failed to record CommandBuffer");
+}
+
+void Swiftcanon::recordSceneDraws(VkCommandBuffer command_buffer, uint32_t firstInstance, uint32_t instanceCount)
+{
+    const MeshLod& lod = mesh.lods()[currentLod];
+    vkCmdBindIndexBuffer        (command_buffer, indexBuffer, 0, mesh.indexStride() == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+    for (uint32_t i = lod.firstSubMesh; i < lod.firstSubMesh + lod.subMeshCount; i++) {
+        const SubMesh& subMesh = mesh.subMeshes()[i];
+        vkCmdDrawIndexed        (command_buffer, subMesh.indexCount, instanceCount, subMesh.firstIndex, subMesh.vertexOffset, firstInstance);
+    }
+}
+
+// Draws [firstDraw, endDraw) of the per-object draw list: one draw per instance and sub-mesh of the current LOD,
+// instance-major, the way a scene of separate objects is drawn
+void Swiftcanon::recordDrawRange(VkCommandBuffer command_buffer, uint32_t firstDraw, uint32_t endDraw)
+{
+    const MeshLod& lod = mesh.lods()[currentLod];
+    vkCmdBindIndexBuffer        (command_buffer, indexBuffer, 0, mesh.indexStride() == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+    for (uint32_t draw = firstDraw; draw < endDraw; draw++) {
+        uint32_t instance = draw / lod.subMeshCount;
+        const SubMesh& subMesh = mesh.subMeshes()[lod.firstSubMesh + draw % lod.subMeshCount];
+        vkCmdDrawIndexed        (command_buffer, subMesh.indexCount, 1, subMesh.firstIndex, subMesh.vertexOffset, instance);
     }
 }
 
+void Swiftcanon::recordSecondaryDraws(VkCommandBuffer command_buffer, const VkRenderPassBeginInfo& renderPassInfo, uint32_t commandIndex, uint32_t threadCount)
+{
+    // The draw list is split into contiguous ranges, one per thread, so every secondary records distinct draws.
+    // Secondaries inherit no state, each binds everything again. Pool threads past threadCount stay idle.
+    const MeshLod& lod = mesh.lods()[currentLod];
+    uint32_t drawCount = instances.count() * lod.subMeshCount;
+    VkCommandBuffer* secondaries = &secondaryCommandBuffers[commandIndex * recordWorkers->size()];
+    std::vector<VkResult> results(threadCount, VK_SUCCESS);
+
+    recordWorkers->run([&](uint32_t thread) {
+        if (thread >= threadCount) {
+            return;
+        }
+        CpuProfileScope scope("recordSecondaryDraws");
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType           = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass      = renderPassInfo.renderPass;
+        inheritanceInfo.subpass         = 0;
+        inheritanceInfo.framebuffer     = renderPassInfo.framebuffer;
+        if (statsQueryPool != VK_NULL_HANDLE) {
+            inheritanceInfo.pipelineStatistics = PIPELINE_STATISTICS_FLAGS;
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType                 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags                 = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        beginInfo.pInheritanceInfo      = &inheritanceInfo;
+
+        // Beginning implicitly resets the buffer, its pool allows that per buffer
+        results[thread] = vkBeginCommandBuffer(secondaries[thread], &beginInfo);
+        if (results[thread] != VK_SUCCESS) {
+            return;
+        }
+        uint32_t first = static_cast<uint32_t>(uint64_t(drawCount) * thread / threadCount);
+        uint32_t end = static_cast<uint32_t>(uint64_t(drawCount) * (thread + 1) / threadCount);
+        bindGraphicsState(secondaries[thread]);
+        recordDrawRange(secondaries[thread], first, end);
+        results[thread] = vkEndCommandBuffer(secondaries[thread]);
+    });
+
+    for (VkResult result : results) {
+        if (result != VK_SUCCESS) {
+            std::cerr << string_VkResult(result) << std::endl;
+            throw std::runtime_error("[VULKAN] Failed to record secondary CommandBuffer");
+        }
+    }
+    vkCmdExecuteCommands(command_buffer, threadCount, secondaries);
+}
+
 void Swiftcanon::createSyncObjects()
 {
     imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
@@ -1083,12 +2440,12 @@ void Swiftcanon::createSyncObjects()
     }
 }
 
-VkShaderModule Swiftcanon::createShaderModule(const std::vector<char>& code)
+VkShaderModule Swiftcanon::createShaderModule(const uint32_t* code, size_t size)
 {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode    = reinterpret_cast<const uint32_t*>(code.data());
+    createInfo.codeSize = size;
+    createInfo.pCode    = code;
 
     VkShaderModule shaderModule;
     VkResult result = vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule);
@@ -1101,69 +2458,66 @@ VkShaderModule Swiftcanon::createShaderModule(const std::vector<char>& code)
     }
 }
 
-std::vector<char> Swiftcanon::readFile(const std::string& filename) {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-    if (!file.is_open()) {
-        throw std::runtime_error("[READFILE] Failed to open file: " + filename);
-    }
-
-    size_t fileSize = (size_t) file.tellg();
-    std::vector<char> buffer(fileSize);
-
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-
-    return buffer;
-}
-
 void Swiftcanon::loadModel(const char* path)
 {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
+    CpuProfileScope scope("loadModel");
+    std::string cachePath = meshCachePath(path);
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path)) {
-        throw std::runtime_error(warn + err);
+    // The cache is keyed on the source contents, a missing source means only the cooked mesh was shipped
+    std::optional<uint64_t> sourceHash;
+    MappedFile source;
+    if (source.open(path)) {
+        sourceHash = hashBytes(source.data(), source.size());
     }
+    source.close();
 
-    for (const auto& shape : shapes) {
-        for (const auto& index : shape.mesh.indices) {
-            Vertex vertex{};
-            vertex.pos = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            };
-
-            vertex.color = {
-                attrib.normals[3 * index.vertex_index + 0],
-                attrib.normals[3 * index.vertex_index + 1],
-                attrib.normals[3 * index.vertex_index + 2]
-            };
+    if (mesh.open(cachePath, sourceHash)) {
+        std::cout << "[MESH] Loaded cooked mesh " << cachePath << std::endl;
+    }
+    else {
+        if (!sourceHash.has_value()) {
+            throw std::runtime_error("[MESH] Failed to open model: " + std::string(path));
+        }
+        std::cout << "[MESH] Mesh cache " << cachePath << " missing or stale, cooking " << path << std::endl;
 
-            vertices.push_back(vertex);
-            indices.push_back(indices.size());
+        std::vector<char> image = cookMesh(path, sourceHash.value());
+        if (!writeMeshCache(cachePath, image) || !mesh.open(cachePath, sourceHash)) {
+            std::cout << "[MESH] WARNING: Failed to write mesh cache " << cachePath << ", keeping cooked mesh in memory" << std::endl;
+            mesh.adopt(std::move(image));
         }
     }
-}
 
-uint32_t Swiftcanon::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
-{
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    std::cout << "[MESH]   " << mesh.sectionCount(MESH_SECTION_VERTICES) << " vertices, " << mesh.lods()[0].indexCount / 3 << " triangles, "
+              << mesh.sectionCount(MESH_SECTION_SUBMESHES) << " sub-meshes, " << mesh.indexStride() * 8 << "-bit indices" << std::endl;
 
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
+    if (vertexLayout.format != VERTEX_FORMAT_FLOAT32) {
+        MeshBounds bounds = mesh.bounds();
+        meshDequantize = glm::scale(glm::translate(glm::mat4(1.0f), bounds.min), bounds.max - bounds.min);
+    }
+    // The cull pass tests meshlets against a single model transform
+    if (options.clusterCulling && options.instanceCount > 1) {
+        std::cout << "[MESH] Cluster culling supports a single instance, disabling it for " << options.instanceCount << " instances" << std::endl;
+        options.clusterCulling = false;
     }
-    throw std::runtime_error("[Vulkan] Failed to find suitable Memory Type");
+    if (options.clusterCulling && mesh.sectionCount(MESH_SECTION_MESHLETS) == 0) {
+        std::cout << "[MESH] WARNING: Mesh has no meshlets, disabling cluster culling" << std::endl;
+        options.clusterCulling = false;
+    }
+    if (options.forcedLod >= static_cast<int>(mesh.sectionCount(MESH_SECTION_LODS))) {
+        std::cout << "[MESH] WARNING: Mesh has no LOD " << options.forcedLod << ", using LOD " << mesh.sectionCount(MESH_SECTION_LODS) - 1 << std::endl;
+        options.forcedLod = static_cast<int>(mesh.sectionCount(MESH_SECTION_LODS)) - 1;
+    }
+    std::cout << "[MESH]   " << mesh.sectionCount(MESH_SECTION_LODS) << " LODs:" << std::endl;
+    for (uint64_t i = 0; i < mesh.sectionCount(MESH_SECTION_LODS); i++) {
+        std::cout << "[MESH]     LOD " << i << ": " << mesh.lods()[i].indexCount / 3 << " triangles, error " << mesh.lods()[i].error << std::endl;
+    }
+    std::cout << "[MESH]   " << mesh.sectionCount(MESH_SECTION_MESHLETS) << " meshlets, cluster culling " << (options.clusterCulling ? "enabled" : "disabled") << std::endl;
+    std::cout << "[MESH]   Vertex format " << vertexFormatName(vertexLayout.format) << ", " << vertexLayout.stride << " bytes per vertex ("
+              << mesh.sectionCount(MESH_SECTION_VERTICES) * vertexLayout.stride / 1024 << " KB)" << std::endl;
 }
 
-void Swiftcanon::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void Swiftcanon::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory,
+                              VkMemoryPropertyFlags preferredProperties)
 {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType        = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1180,52 +2534,8 @@ void Swiftcanon::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMem
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType             = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize    = memRequirements.size;
-    allocInfo.memoryTypeIndex   = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    result = vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory);
-    if (result != VK_SUCCESS) {
-        std::cerr << string_VkResult(result) << std::endl;
-        throw std::runtime_error("[VULKAN] Failed to allocate Buffer Memory");
-    }
-
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
-}
-
-void Swiftcanon::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
-{
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType                 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level                 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool           = commandPool;
-    allocInfo.commandBufferCount    = 1;
-
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType                 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags                 = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-    
-    VkBufferCopy copyRegion{};
-    copyRegion.srcOffset            = 0; // Optional
-    copyRegion.dstOffset            = 0; // Optional
-    copyRegion.size                 = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    vkEndCommandBuffer(commandBuffer);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount   = 1;
-    submitInfo.pCommandBuffers      = &commandBuffer;
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    
-    vkQueueWaitIdle(graphicsQueue);
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+    bufferMemory = memoryAllocator.allocate(memRequirements, properties, ALLOCATION_KIND_LINEAR, false, preferredProperties);
+    vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset);
 }
 
 VkFormat Swiftcanon::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
@@ -1245,7 +2555,7 @@ VkFormat Swiftcanon::findSupportedFormat(const std::vector<VkFormat>& candidates
 
 void Swiftcanon::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
                             VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-                            VkImage& image, VkDeviceMemory& imageMemory)
+                            VkImage& image, MemoryAllocation& imageMemory, uint32_t mipLevels)
 {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1253,7 +2563,7 @@ void Swiftcanon::createImage(uint32_t width, uint32_t height, VkFormat format, V
     imageInfo.extent.width  = width;
     imageInfo.extent.height = height;
     imageInfo.extent.depth  = 1;
-    imageInfo.mipLevels     = 1;
+    imageInfo.mipLevels     = mipLevels;
     imageInfo.arrayLayers   = 1;
     imageInfo.format        = format;
     imageInfo.tiling        = tiling;
@@ -1271,21 +2581,18 @@ void Swiftcanon::createImage(uint32_t width, uint32_t height, VkFormat format, V
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(device, image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType             = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize    = memRequirements.size;
-    allocInfo.memoryTypeIndex   = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    result = vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory);
-    if (result != VK_SUCCESS) {
-        std::cerr << string_VkResult(result) << std::endl;
-        throw std::runtime_error("[VULKAN] Failed to allocate Image Memory");
-    }
-
-    vkBindImageMemory(device, image, imageMemory, 0);
+    // Render targets are recreated with the swapchain, giving them their own memory keeps resizes from fragmenting blocks
+    const VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    imageMemory = memoryAllocator.allocate(
+        memRequirements,
+        properties,
+        tiling == VK_IMAGE_TILING_OPTIMAL ? ALLOCATION_KIND_OPTIMAL : ALLOCATION_KIND_LINEAR,
+        (usage & attachmentUsage) != 0
+    );
+    vkBindImageMemory(device, image, imageMemory.memory, imageMemory.offset);
 }
 
-VkImageView Swiftcanon::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkImageView Swiftcanon::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t baseMipLevel, uint32_t levelCount)
 {
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType                              = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -1293,8 +2600,8 @@ VkImageView Swiftcanon::createImageView(VkImage image, VkFormat format, VkImageA
     viewInfo.viewType                           = VK_IMAGE_VIEW_TYPE_2D;
     viewInfo.format                             = format;
     viewInfo.subresourceRange.aspectMask        = aspectFlags;
-    viewInfo.subresourceRange.baseMipLevel      = 0;
-    viewInfo.subresourceRange.levelCount        = 1;
+    viewInfo.subresourceRange.baseMipLevel      = baseMipLevel;
+    viewInfo.subresourceRange.levelCount        = levelCount;
     viewInfo.subresourceRange.baseArrayLayer    = 0;
     viewInfo.subresourceRange.layerCount        = 1;
 
@@ -1310,19 +2617,70 @@ VkImageView Swiftcanon::createImageView(VkImage image, VkFormat format, VkImageA
 
 void Swiftcanon::mainLoop()
 {
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+    while (!shouldClose()) {
+        if (!options.headless) {
+            glfwPollEvents();
+        }
         drawFrame();
     }
     vkDeviceWaitIdle(device);
+    for (uint32_t i = 0; i < gpuTimingFrames.size(); i++) {
+        collectGpuTimings(i);
+    }
+    for (uint32_t i = 0; i < pipelineStatsFrames.size(); i++) {
+        collectPipelineStats(i);
+    }
+}
+
+bool Swiftcanon::shouldClose()
+{
+    uint64_t warmupFrames = options.benchmark ? options.warmupFrames : 0;
+    if (options.frameCount > 0 && submittedFrames >= options.frameCount + warmupFrames) {
+        return true;
+    }
+    return !options.headless && glfwWindowShouldClose(window);
+}
+
+// Seconds since construction, GLFW's timer isn't available without a window
+double Swiftcanon::elapsedTime() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
 }
 
 void Swiftcanon::drawFrame()
 {
+    CpuProfileScope frameScope("drawFrame");
     uint32_t imageIndex;
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    if (options.benchmark) {
+        benchmark.beginFrame(submittedFrames);
+    }
+    {
+        CpuProfileScope scope("vkWaitForFences");
+        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    }
+    // CPU frame time leaves out the wait for the GPU above
+    auto cpuStart = std::chrono::steady_clock::now();
+    collectGpuTimings(currentFrame);
+    collectPipelineStats(currentFrame);
+    stagingRing.retire();
+    // Every frame before the one that last used this slot was waited for earlier, in this slot or the other
+    if (submittedFrames >= static_cast<uint64_t>(MAX_FRAMES_IN_FLIGHT)) {
+        runDeferredDeletions(submittedFrames - MAX_FRAMES_IN_FLIGHT + 1);
+    }
+    if (!instanceCullSetsStale.empty() && instanceCullSetsStale[currentFrame]) {
+        writeInstanceCullDescriptorSet(currentFrame);
+        instanceCullSetsStale[currentFrame] = false;
+    }
     
-    VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    // Headless targets are owned per frame slot, the fence above already made this one free again
+    VkResult result = VK_SUCCESS;
+    if (options.headless) {
+        imageIndex = currentFrame;
+    }
+    else {
+        CpuProfileScope scope("vkAcquireNextImageKHR");
+        result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    }
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
         recreateSwapChain();
         return;
@@ -1332,9 +2690,26 @@ void Swiftcanon::drawFrame()
     }
 
     vkResetFences(device, 1, &inFlightFences[currentFrame]);
-    vkResetCommandBuffer(commandBuffers[currentFrame], 0);
-    recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
     updateUniformBuffer(currentFrame);
+    updateInstanceBuffer(currentFrame);
+    collectCullStats(currentFrame);
+
+    // Per-frame data only flows through buffers, the commands themselves change with the LOD, the instance count
+    // and replaced resources. Anything else replays what was recorded for this frame slot and image last time.
+    uint32_t commandIndex = currentFrame * static_cast<uint32_t>(swapChainImages.size()) + imageIndex;
+    VkCommandBuffer commandBuffer = commandBuffers[commandIndex];
+    RecordedCommands& recorded = recordedCommands[commandIndex];
+    uint32_t pipelinesReady = pipelineManager.readyCount();
+    if (!options.cacheCommands || !recorded.valid || recorded.epoch != commandBufferEpoch
+        || recorded.lod != currentLod || recorded.instanceCount != instances.count() || recorded.pipelinesReady != pipelinesReady) {
+        vkResetCommandBuffer(commandBuffer, 0);
+        recordCommandBuffer(commandBuffer, imageIndex);
+        recorded.valid          = true;
+        recorded.epoch          = commandBufferEpoch;
+        recorded.lod            = currentLod;
+        recorded.instanceCount  = instances.count();
+        recorded.pipelinesReady = pipelinesReady;
+    }
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -1345,18 +2720,55 @@ void Swiftcanon::drawFrame()
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+    submitInfo.pCommandBuffers = &commandBuffer;
 
     VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
+    // Nothing is acquired or presented, the frame fence alone paces headless frames
+    if (options.headless) {
+        submitInfo.waitSemaphoreCount = 0;
+        submitInfo.signalSemaphoreCount = 0;
+    }
 
-    result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]);
+    // Uploads staged while recording go out ahead of the frame on the same queue
+    {
+        CpuProfileScope scope("vkQueueSubmit");
+        stagingRing.flush();
+        result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]);
+    }
     if (result != VK_SUCCESS) {
         std::cerr << string_VkResult(result) << std::endl;
         throw std::runtime_error("[VULKAN] Failed to submit Draw CommandBuffer");
     }
+    if (gpuProfiler.enabled()) {
+        gpuTimingFrames[currentFrame] = submittedFrames;
+    }
+    if (statsQueryPool != VK_NULL_HANDLE) {
+        pipelineStatsFrames[currentFrame] = submittedFrames;
+    }
+    submittedFrames++;
 
+    if (!options.headless) {
+        presentFrame(imageIndex, signalSemaphores[0]);
+    }
+
+    // Counts from construction, so this covers pipeline creation and every upload before the first frame
+    if (!firstFramePresented) {
+        firstFramePresented = true;
+        const char* cacheState = !options.pipelineCache ? "disabled" : pipelineCacheLoaded ? "warm" : "cold";
+        std::cout << "[VULKAN] Time to first frame: " << elapsedTime() * 1000.0 << " ms (pipeline cache " << cacheState << ")" << std::endl;
+    }
+
+    if (options.benchmark) {
+        benchmark.addCpuFrame(submittedFrames - 1, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count());
+    }
+    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+void Swiftcanon::presentFrame(uint32_t imageIndex, VkSemaphore renderFinished)
+{
+    VkSemaphore signalSemaphores[] = { renderFinished };
     VkPresentInfoKHR presentInfo{};
     VkSwapchainKHR swapChains[] = { swapChain };
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1367,7 +2779,11 @@ void Swiftcanon::drawFrame()
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = nullptr;  // Optional
 
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    VkResult result;
+    {
+        CpuProfileScope scope("vkQueuePresentKHR");
+        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    }
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
         std::cout << "[Vulkan] Recreating SwapChain" << std::endl;
         framebufferResized = false;
@@ -1376,50 +2792,544 @@ void Swiftcanon::drawFrame()
     else if (result != VK_SUCCESS) {
         throw std::runtime_error("[VULKAN] Failed to present SwapChain Image");
     }
+}
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+void Swiftcanon::createInstances()
+{
+    CpuProfileScope scope("createInstances");
+    // Square grid on the ground plane centred on the origin, spaced so neighbours never overlap while rotating
+    MeshBounds bounds = mesh.bounds();
+    float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+    float spacing = radius * 2.0f * 1.1f;
+    uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(options.instanceCount))));
+    float gridOffset = (side - 1) * spacing * 0.5f;
+
+    instances = InstanceSet(MAX_FRAMES_IN_FLIGHT);
+    for (uint32_t i = 0; i < options.instanceCount; i++) {
+        uint32_t x = i % side;
+        uint32_t y = i / side;
+        InstanceData instance{};
+        instance.model = glm::translate(glm::mat4(1.0f), glm::vec3(x * spacing - gridOffset, y * spacing - gridOffset, 0.0f));
+        // A single instance keeps the plain normal colouring
+        instance.color = options.instanceCount == 1 ? glm::vec4(1.0f)
+                       : glm::vec4(0.5f + 0.5f * x / side, 0.5f + 0.5f * y / side, 1.0f - 0.5f * (x + y) / (2 * side), 1.0f);
+        instances.add(instance);
+    }
+    sceneScale = (gridOffset * std::sqrt(2.0f) + radius) / radius;
+
+    // Meshlet culling already drives the single instance indirectly. firstInstance selects the instance
+    // attributes of each indirect draw, so drawIndirectFirstInstance is the minimum for GPU culling.
+    indirectDrawMode = INDIRECT_DRAW_NONE;
+    if (options.gpuCulling && !options.clusterCulling && physicalDeviceDetails.drawIndirectFirstInstance) {
+        if (physicalDeviceDetails.drawIndirectCount) {
+            indirectDrawMode = INDIRECT_DRAW_COUNT;
+        }
+        else if (physicalDeviceDetails.multiDrawIndirect) {
+            indirectDrawMode = INDIRECT_DRAW_MULTI;
+        }
+    }
+    const char* indirectDrawModeNames[] = { "vkCmdDrawIndexedIndirectCount", "vkCmdDrawIndexedIndirect", "instanced vkCmdDrawIndexed" };
+    if (indirectDrawMode == INDIRECT_DRAW_NONE) {
+        options.occlusionCulling = false;
+    }
+    std::cout << "[MESH] Instances drawn with " << indirectDrawModeNames[indirectDrawMode]
+              << (indirectDrawMode == INDIRECT_DRAW_NONE ? "" : options.occlusionCulling ? " after GPU frustum and Hi-Z occlusion culling" : " after GPU frustum culling")
+              << std::endl;
+
+    const MeshLod* lods = mesh.lods();
+    maxLodSubMeshes = 0;
+    for (size_t i = 0; i < mesh.sectionCount(MESH_SECTION_LODS); i++) {
+        maxLodSubMeshes = std::max(maxLodSubMeshes, lods[i].subMeshCount);
+    }
+
+    // Buffers are created by updateInstanceBuffer once the instance count is known for each frame
+    instanceBuffers.assign(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    instanceBuffersMemory.assign(MAX_FRAMES_IN_FLIGHT, MemoryAllocation{});
+    instanceBufferCapacity.assign(MAX_FRAMES_IN_FLIGHT, 0);
+    instanceDrawBuffers.assign(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    instanceDrawBuffersMemory.assign(MAX_FRAMES_IN_FLIGHT, MemoryAllocation{});
+    instanceLateDrawBuffers.assign(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    instanceLateDrawBuffersMemory.assign(MAX_FRAMES_IN_FLIGHT, MemoryAllocation{});
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        updateInstanceBuffer(static_cast<uint32_t>(i));
+    }
+    std::cout << "[MESH] " << instances.count() << " instances on a " << side << "x" << side << " grid" << std::endl;
+}
+
+void Swiftcanon::updateInstanceBuffer(uint32_t currentImage)
+{
+    CpuProfileScope scope("updateInstanceBuffer");
+    // Only called once this frame's fence has signalled, so its buffer can be replaced without waiting
+    uint32_t count = std::max(instances.count(), 1u);
+    if (count > instanceBufferCapacity[currentImage]) {
+        if (instanceBuffers[currentImage] != VK_NULL_HANDLE) {
+            vkDestroyBuffer(device, instanceBuffers[currentImage], nullptr);
+            memoryAllocator.free(instanceBuffersMemory[currentImage]);
+        }
+        instanceBufferCapacity[currentImage] = std::max(count, instanceBufferCapacity[currentImage] * 2);
+        // Written by the CPU every frame, device local host visible memory (resizable BAR) is read faster by vertex input
+        VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        if (indirectDrawMode != INDIRECT_DRAW_NONE) {
+            usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        }
+        createBuffer(instanceBufferCapacity[currentImage] * sizeof(InstanceData), usage,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     instanceBuffers[currentImage], instanceBuffersMemory[currentImage], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        instances.invalidate(currentImage);
+        commandBufferEpoch++;
+
+        if (indirectDrawMode != INDIRECT_DRAW_NONE) {
+            VkDeviceSize drawBufferSize = INSTANCE_DRAW_COMMANDS_OFFSET + VkDeviceSize(instanceBufferCapacity[currentImage]) * maxLodSubMeshes * sizeof(VkDrawIndexedIndirectCommand);
+            VkBuffer* drawBuffers[] = { &instanceDrawBuffers[currentImage], &instanceLateDrawBuffers[currentImage] };
+            MemoryAllocation* drawBuffersMemory[] = { &instanceDrawBuffersMemory[currentImage], &instanceLateDrawBuffersMemory[currentImage] };
+            for (int i = 0; i < 2; i++) {
+                if (*drawBuffers[i] != VK_NULL_HANDLE) {
+                    vkDestroyBuffer(device, *drawBuffers[i], nullptr);
+                    memoryAllocator.free(*drawBuffersMemory[i]);
+                }
+                createBuffer(
+                    drawBufferSize,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    *drawBuffers[i],
+                    *drawBuffersMemory[i]
+                );
+            }
+
+            // Shared by every frame, so growing it has to wait for the other frame in flight. Instance counts
+            // only grow by doubling, this happens a handful of times at most.
+            bool visibilityGrown = false;
+            if (instanceBufferCapacity[currentImage] > instanceVisibilityCapacity) {
+                if (instanceVisibilityBuffer != VK_NULL_HANDLE) {
+                    vkQueueWaitIdle(graphicsQueue);
+                    vkDestroyBuffer(device, instanceVisibilityBuffer, nullptr);
+                    memoryAllocator.free(instanceVisibilityBufferMemory);
+                }
+                instanceVisibilityCapacity = instanceBufferCapacity[currentImage];
+                createBuffer(
+                    VkDeviceSize(instanceVisibilityCapacity) * sizeof(uint32_t),
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    instanceVisibilityBuffer,
+                    instanceVisibilityBufferMemory
+                );
+                // Nothing counts as visible last frame, the late pass then tests and draws everything. Staged
+                // rather than filled by the frame so recorded command buffers don't carry a one-off reset.
+                std::vector<uint32_t> hidden(instanceVisibilityCapacity, 0);
+                stagingRing.upload(instanceVisibilityBuffer, 0, hidden.data(), hidden.size() * sizeof(uint32_t));
+                visibilityGrown = true;
+            }
+
+            // Before createDescriptorSets the sets don't exist yet and get written there
+            if (!instanceCullDescriptorSets.empty()) {
+                for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+                    if (i == currentImage || visibilityGrown) {
+                        writeInstanceCullDescriptorSet(static_cast<uint32_t>(i));
+                    }
+                }
+            }
+        }
+    }
+    instances.writeDirty(currentImage, instanceBuffersMemory[currentImage].mapped);
+}
+
+void Swiftcanon::selectLod()
+{
+    const MeshLod* lods = mesh.lods();
+    uint32_t lodCount = static_cast<uint32_t>(mesh.sectionCount(MESH_SECTION_LODS));
+
+    // Project each LOD's error at the closest point of the mesh bounding sphere and keep the coarsest one that stays
+    // under the pixel threshold. projMatrix[1][1] is cot(fov / 2), so this is pixels per unit at distance 1.
+    // Every instance draws the same LOD, so the closest one decides. Its distance is bounded from below by the
+    // cached instance placement instead of visiting every instance each frame, exact for the translated grid.
+    MeshBounds bounds = mesh.bounds();
+    glm::vec3 center = glm::vec3(modelMatrix * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+    float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+    float closest = std::numeric_limits<float>::max();
+    if (instances.count() > 0) {
+        const InstanceBounds& placement = instances.bounds();
+        glm::vec3 nearest = glm::clamp(cameraPosition, placement.min + center, placement.max + center);
+        closest = glm::length(cameraPosition - nearest) - placement.maxLinearDeviation * glm::length(center);
+    }
+    float distance = std::max(closest - radius, 0.1f);
+    float pixelsPerUnit = std::abs(projMatrix[1][1]) * swapChainExtent.height * 0.5f / distance;
+
+    if (options.forcedLod >= 0) {
+        currentLod = static_cast<uint32_t>(options.forcedLod);
+    }
+    else {
+        currentLod = 0;
+        while (currentLod + 1 < lodCount && lods[currentLod + 1].error * pixelsPerUnit <= options.lodErrorPixels) {
+            currentLod++;
+        }
+    }
+
+    // Triangle reduction relative to always drawing LOD 0, averaged over the frames of each logging interval
+    lodTrianglesDrawn += lods[currentLod].indexCount / 3;
+    lodTrianglesFull += lods[0].indexCount / 3;
+    lodStatsFrames++;
+    double now = elapsedTime();
+    if (now - lodStatsStartTime >= 1.0) {
+        float reduction = 100.0f * (1.0f - static_cast<float>(lodTrianglesDrawn) / std::max<uint64_t>(lodTrianglesFull, 1));
+        std::cout << "[LOD] LOD " << currentLod << " (" << lods[currentLod].error * pixelsPerUnit << " px error), "
+                  << lodTrianglesDrawn / lodStatsFrames << " / " << lodTrianglesFull / lodStatsFrames << " triangles per frame, "
+                  << reduction << "% reduction" << std::endl;
+        lodTrianglesDrawn = 0;
+        lodTrianglesFull = 0;
+        lodStatsFrames = 0;
+        lodStatsStartTime = now;
+    }
 }
 
 void Swiftcanon::updateUniformBuffer(uint32_t currentImage)
 {
+    CpuProfileScope scope("updateUniformBuffer");
     static auto startTime = std::chrono::high_resolution_clock::now();
     auto currentTime = std::chrono::high_resolution_clock::now();
     float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+    if (options.benchmark) {
+        time = submittedFrames * BENCHMARK_TIME_STEP;
+    }
+
+    glm::vec3 cameraTarget = glm::vec3(0.0f, 0.0f, 8.0f);
+    glm::vec3 cameraOffset = glm::vec3(32.0f, 32.0f, 12.0f) - cameraTarget;
+    // Scripted benchmark path: the camera orbits against the scene's rotation and dollies between 40% and 100% of
+    // the default distance every 20 seconds, so LOD selection and culling change over the run
+    if (options.benchmark) {
+        float dolly = 0.7f + 0.3f * std::cos(time * glm::radians(18.0f));
+        cameraOffset = glm::vec3(glm::rotate(glm::mat4(1.0f), time * glm::radians(-12.0f), glm::vec3(0.0f, 0.0f, 1.0f)) * glm::vec4(cameraOffset, 0.0f)) * dolly;
+    }
+    cameraPosition = cameraTarget + cameraOffset * sceneScale;
+    modelMatrix = glm::rotate(glm::mat4(1.0f), time * glm::radians(24.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    viewMatrix = glm::lookAt(cameraPosition, cameraTarget, glm::vec3(0.0f, 0.0f, 1.0f));
+    projMatrix = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float) swapChainExtent.height, 0.1f, 100.0f * sceneScale);
+    projMatrix[1][1] *= -1;
 
     UniformBufferObject ubo{};
-    ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(24.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.view = glm::lookAt(glm::vec3(32.0f, 32.0f, 12.0f), glm::vec3(0.0f, 0.0f, 8.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float) swapChainExtent.height, 0.1f, 100.0f);
-    ubo.proj[1][1] *= -1;
+    ubo.model = modelMatrix * meshDequantize;
+    ubo.view = viewMatrix;
+    ubo.proj = projMatrix;
+    selectLod();
     memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+    updateCullCamera(currentImage);
+}
+
+void Swiftcanon::createGpuProfiler()
+{
+    if (!options.gpuProfiler && !options.benchmark) {
+        return;
+    }
+    if (physicalDeviceDetails.timestampValidBits == 0) {
+        std::cout << "[GPU] Graphics queue has no timestamps, GPU times are not measured" << std::endl;
+        return;
+    }
+    gpuProfiler.init(device, MAX_FRAMES_IN_FLIGHT, physicalDeviceDetails.timestampPeriod, physicalDeviceDetails.timestampValidBits);
+    gpuTimingFrames.assign(MAX_FRAMES_IN_FLIGHT, UINT64_MAX);
+}
+
+void Swiftcanon::beginGpuRegion(VkCommandBuffer command_buffer, const char* name)
+{
+    if (gpuProfiler.enabled()) {
+        gpuProfiler.begin(command_buffer, currentFrame, gpuProfiler.region(name));
+    }
+}
+
+void Swiftcanon::endGpuRegion(VkCommandBuffer command_buffer, const char* name)
+{
+    if (gpuProfiler.enabled()) {
+        gpuProfiler.end(command_buffer, currentFrame, gpuProfiler.region(name));
+    }
+}
+
+// Called once the slot's fence has signalled, so the results are there without waiting
+void Swiftcanon::collectGpuTimings(uint32_t frame)
+{
+    if (!gpuProfiler.enabled() || gpuTimingFrames[frame] == UINT64_MAX) {
+        return;
+    }
+    uint64_t timedFrame = gpuTimingFrames[frame];
+    gpuTimingFrames[frame] = UINT64_MAX;
+    if (!gpuProfiler.collect(frame)) {
+        return;
+    }
+
+    if (options.benchmark) {
+        for (uint32_t i = 0; i < gpuProfiler.regionCount(); i++) {
+            double milliseconds = gpuProfiler.lastMs(i);
+            if (milliseconds < 0.0) {
+                continue;
+            }
+            if (gpuProfiler.regionName(i) == "frame") {
+                benchmark.addGpuFrame(timedFrame, milliseconds);
+            }
+            else {
+                benchmark.addGpuPass(timedFrame, gpuProfiler.regionName(i), milliseconds);
+            }
+        }
+    }
+
+    double now = elapsedTime();
+    if (options.gpuProfiler && now - gpuStatsStartTime >= 1.0) {
+        std::cout << "[GPU]";
+        for (const GpuRegionStats& stats : gpuProfiler.stats()) {
+            if (stats.lastMs >= 0.0) {
+                std::cout << " " << stats.name << " " << stats.averageMs << " ms,";
+            }
+        }
+        std::cout << " averaged over " << GPU_PROFILER_ROLLING_FRAMES << " frames" << std::endl;
+        gpuStatsStartTime = now;
+    }
+}
+
+void Swiftcanon::createPipelineStatsQueries()
+{
+    if (!options.pipelineStats) {
+        return;
+    }
+    if (!physicalDeviceDetails.pipelineStatisticsQuery) {
+        std::cout << "[GPU] Device has no pipeline statistics queries, pipeline statistics are not counted" << std::endl;
+        return;
+    }
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType                 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType             = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    queryPoolInfo.queryCount            = MAX_FRAMES_IN_FLIGHT;
+    queryPoolInfo.pipelineStatistics    = PIPELINE_STATISTICS_FLAGS;
+
+    VkResult result = vkCreateQueryPool(device, &queryPoolInfo, nullptr, &statsQueryPool);
+    if (result != VK_SUCCESS) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to create pipeline statistics QueryPool");
+    }
+    pipelineStatsFrames.assign(MAX_FRAMES_IN_FLIGHT, UINT64_MAX);
+}
+
+// Called once the slot's fence has signalled, like collectGpuTimings
+void Swiftcanon::collectPipelineStats(uint32_t frame)
+{
+    if (statsQueryPool == VK_NULL_HANDLE || pipelineStatsFrames[frame] == UINT64_MAX) {
+        return;
+    }
+    uint64_t countedFrame = pipelineStatsFrames[frame];
+    pipelineStatsFrames[frame] = UINT64_MAX;
+
+    // The counters in bit order followed by the availability
+    uint64_t results[sizeof(PipelineStats) / sizeof(uint64_t) + 1];
+    VkResult result = vkGetQueryPoolResults(device, statsQueryPool, frame, 1, sizeof(results), results, sizeof(results),
+                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        std::cerr << string_VkResult(result) << std::endl;
+        throw std::runtime_error("[VULKAN] Failed to read pipeline statistics query");
+    }
+    if (results[sizeof(PipelineStats) / sizeof(uint64_t)] == 0) {
+        return;
+    }
+    memcpy(&lastPipelineStats, results, sizeof(PipelineStats));
+
+    const std::pair<const char*, uint64_t> counters[] = {
+        {"inputVertices",               lastPipelineStats.inputVertices},
+        {"inputPrimitives",             lastPipelineStats.inputPrimitives},
+        {"vertexShaderInvocations",     lastPipelineStats.vertexShaderInvocations},
+        {"clippingInvocations",         lastPipelineStats.clippingInvocations},
+        {"clippingPrimitives",          lastPipelineStats.clippingPrimitives},
+        {"fragmentShaderInvocations",   lastPipelineStats.fragmentShaderInvocations},
+    };
+    if (options.benchmark) {
+        for (const auto& counter : counters) {
+            benchmark.addCounter(countedFrame, counter.first, static_cast<double>(counter.second));
+        }
+    }
+
+    pipelineStatsTotal.inputVertices                += lastPipelineStats.inputVertices;
+    pipelineStatsTotal.inputPrimitives              += lastPipelineStats.inputPrimitives;
+    pipelineStatsTotal.vertexShaderInvocations      += lastPipelineStats.vertexShaderInvocations;
+    pipelineStatsTotal.clippingInvocations          += lastPipelineStats.clippingInvocations;
+    pipelineStatsTotal.clippingPrimitives           += lastPipelineStats.clippingPrimitives;
+    pipelineStatsTotal.fragmentShaderInvocations    += lastPipelineStats.fragmentShaderInvocations;
+    pipelineStatsCount++;
+
+    // Fragments per pixel is the average overdraw, the heat map of --shading overdraw shows where it comes from
+    double now = elapsedTime();
+    if (now - pipelineStatsStartTime >= 1.0) {
+        double pixels = static_cast<double>(swapChainExtent.width) * swapChainExtent.height;
+        std::cout << "[GPU] Pipeline statistics per frame: "
+                  << pipelineStatsTotal.inputVertices / pipelineStatsCount << " vertices, "
+                  << pipelineStatsTotal.inputPrimitives / pipelineStatsCount << " primitives, "
+                  << pipelineStatsTotal.vertexShaderInvocations / pipelineStatsCount << " vertex shader invocations, "
+                  << pipelineStatsTotal.clippingInvocations / pipelineStatsCount << " primitives clipped into "
+                  << pipelineStatsTotal.clippingPrimitives / pipelineStatsCount << ", "
+                  << pipelineStatsTotal.fragmentShaderInvocations / pipelineStatsCount << " fragment shader invocations ("
+                  << pipelineStatsTotal.fragmentShaderInvocations / pipelineStatsCount / pixels << " per pixel)" << std::endl;
+        pipelineStatsTotal = PipelineStats{};
+        pipelineStatsCount = 0;
+        pipelineStatsStartTime = now;
+    }
+}
+
+void Swiftcanon::writeBenchmarkReport()
+{
+    TimingSummary cpu = benchmark.cpuSummary();
+    TimingSummary gpu = benchmark.gpuSummary();
+    double seconds = benchmark.seconds();
+    double fps = seconds > 0.0 ? benchmark.measuredFrames() / seconds : 0.0;
+
+    std::cout << "[BENCHMARK] " << benchmark.measuredFrames() << " frames in " << seconds << " s, " << fps << " fps" << std::endl;
+    std::cout << "[BENCHMARK]   CPU ms: p50 " << cpu.p50 << ", p95 " << cpu.p95 << ", p99 " << cpu.p99 << ", max " << cpu.max << std::endl;
+    if (benchmark.hasGpuFrames()) {
+        std::cout << "[BENCHMARK]   GPU ms: p50 " << gpu.p50 << ", p95 " << gpu.p95 << ", p99 " << gpu.p99 << ", max " << gpu.max << std::endl;
+    }
+    for (const auto& pass : benchmark.gpuPasses()) {
+        std::cout << "[BENCHMARK]     " << pass.first << ": mean " << Benchmark::summarize(pass.second).mean << " ms" << std::endl;
+    }
+
+    // One key per line so runs diff cleanly
+    std::ofstream file(options.benchmarkOutput);
+    if (!file) {
+        throw std::runtime_error("[BENCHMARK] Failed to open " + options.benchmarkOutput);
+    }
+    file << "{" << std::endl;
+    file << "    \"device\": " << Benchmark::jsonString(physicalDeviceDetails.name) << "," << std::endl;
+    file << "    \"resolution\": [" << swapChainExtent.width << ", " << swapChainExtent.height << "]," << std::endl;
+    file << "    \"headless\": " << (options.headless ? "true" : "false") << "," << std::endl;
+    file << "    \"instances\": " << instances.count() << "," << std::endl;
+    file << "    \"vertexFormat\": " << Benchmark::jsonString(vertexFormatName(options.vertexFormat)) << "," << std::endl;
+    file << "    \"shading\": " << Benchmark::jsonString(shadingModeName(featureShadingMode(shaderFeatures))) << "," << std::endl;
+    file << "    \"clusterCulling\": " << (options.clusterCulling ? "true" : "false") << "," << std::endl;
+    file << "    \"gpuCulling\": " << (indirectDrawMode != INDIRECT_DRAW_NONE ? "true" : "false") << "," << std::endl;
+    file << "    \"occlusionCulling\": " << (options.occlusionCulling && indirectDrawMode != INDIRECT_DRAW_NONE ? "true" : "false") << "," << std::endl;
+    file << "    \"cacheCommands\": " << (options.cacheCommands ? "true" : "false") << "," << std::endl;
+    file << "    \"recordThreads\": " << recordWorkers->size() << "," << std::endl;
+    file << "    \"warmupFrames\": " << options.warmupFrames << "," << std::endl;
+    file << "    \"frames\": " << benchmark.measuredFrames() << "," << std::endl;
+    file << "    \"timeStep\": " << BENCHMARK_TIME_STEP << "," << std::endl;
+    file << "    \"seconds\": " << seconds << "," << std::endl;
+    file << "    \"fps\": " << fps << "," << std::endl;
+    file << "    \"cpuFrameMs\": ";
+    Benchmark::writeJson(file, cpu, "    ");
+    file << "," << std::endl;
+    file << "    \"gpuFrameMs\": ";
+    if (benchmark.hasGpuFrames()) {
+        Benchmark::writeJson(file, gpu, "    ");
+    }
+    else {
+        file << "null";
+    }
+    file << "," << std::endl;
+    file << "    \"gpuPassMs\": {";
+    const auto& passes = benchmark.gpuPasses();
+    for (size_t i = 0; i < passes.size(); i++) {
+        file << (i == 0 ? "" : ",") << std::endl << "        " << Benchmark::jsonString(passes[i].first) << ": ";
+        Benchmark::writeJson(file, Benchmark::summarize(passes[i].second), "        ");
+    }
+    file << (passes.empty() ? "}" : "\n    }") << "," << std::endl;
+    file << "    \"pipelineStats\": {";
+    const auto& counters = benchmark.counters();
+    for (size_t i = 0; i < counters.size(); i++) {
+        file << (i == 0 ? "" : ",") << std::endl << "        " << Benchmark::jsonString(counters[i].first) << ": ";
+        Benchmark::writeJson(file, Benchmark::summarize(counters[i].second), "        ");
+    }
+    file << (counters.empty() ? "}" : "\n    }") << std::endl << "}" << std::endl;
+    std::cout << "[BENCHMARK] Results written to " << options.benchmarkOutput << std::endl;
+}
+
+void Swiftcanon::updateCullCamera(uint32_t currentImage)
+{
+    // Meshlet culling happens in mesh space, so only the camera is transformed. Instance culling tests the
+    // mesh bounds after modelMatrix, each instance's own transform is applied on the GPU.
+    MeshBounds bounds = mesh.bounds();
+    CullCamera camera{};
+    extractFrustumPlanes(projMatrix * viewMatrix * modelMatrix, camera.frustumPlanes);
+    camera.cameraPosition   = glm::inverse(modelMatrix) * glm::vec4(cameraPosition, 1.0f);
+    camera.viewProjection   = projMatrix * viewMatrix;
+    camera.boundingSphere   = glm::vec4(glm::vec3(modelMatrix * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f)),
+                                        glm::length(bounds.max - bounds.min) * 0.5f);
+    memcpy(cullCameraBuffersMemory[currentImage].mapped, &camera, sizeof(camera));
 }
 
 void Swiftcanon::cleanup()
 {
+    // Compiles still queued read layouts and render passes destroyed below
+    pipelineManager.destroy();
     cleanupSwapChain();
+    // The device is idle since mainLoop returned
+    runDeferredDeletions(UINT64_MAX);
 for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-    vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+    memoryAllocator.free(uniformBuffersMemory[i]);
+    vkDestroyBuffer(device, cullCameraBuffers[i], nullptr);
+    memoryAllocator.free(cullCameraBuffersMemory[i]);
 }
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        vkDestroyBuffer(device, instanceBuffers[i], nullptr);
+        memoryAllocator.free(instanceBuffersMemory[i]);
+    }
+    if (indirectDrawMode != INDIRECT_DRAW_NONE) {
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vkDestroyBuffer(device, instanceDrawBuffers[i], nullptr);
+            memoryAllocator.free(instanceDrawBuffersMemory[i]);
+            vkDestroyBuffer(device, instanceLateDrawBuffers[i], nullptr);
+            memoryAllocator.free(instanceLateDrawBuffersMemory[i]);
+            vkDestroyBuffer(device, cullStatsBuffers[i], nullptr);
+            memoryAllocator.free(cullStatsBuffersMemory[i]);
+        }
+        vkDestroyBuffer(device, instanceVisibilityBuffer, nullptr);
+        memoryAllocator.free(instanceVisibilityBufferMemory);
+        vkDestroyPipelineLayout(device, hiZPipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, hiZDescriptorSetLayout, nullptr);
+        vkDestroySampler(device, hiZSampler, nullptr);
+        vkDestroyBuffer(device, subMeshBuffer, nullptr);
+        memoryAllocator.free(subMeshBufferMemory);
+        vkDestroyPipelineLayout(device, instanceCullPipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, instanceCullDescriptorSetLayout, nullptr);
+    }
     vkDestroyDescriptorPool(device, descriptorPool, nullptr);
     vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    if (options.clusterCulling) {
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vkDestroyBuffer(device, culledIndexBuffers[i], nullptr);
+            memoryAllocator.free(culledIndexBuffersMemory[i]);
+            vkDestroyBuffer(device, drawIndirectBuffers[i], nullptr);
+            memoryAllocator.free(drawIndirectBuffersMemory[i]);
+        }
+        vkDestroyBuffer(device, meshletBuffer, nullptr);
+        memoryAllocator.free(meshletBufferMemory);
+        vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, cullDescriptorSetLayout, nullptr);
+    }
     vkDestroyBuffer(device, indexBuffer, nullptr);
-    vkFreeMemory(device, indexBufferMemory, nullptr);
+    memoryAllocator.free(indexBufferMemory);
     vkDestroyBuffer(device, vertexBuffer, nullptr);
-    vkFreeMemory(device, vertexBufferMemory, nullptr);
+    memoryAllocator.free(vertexBufferMemory);
+    mesh.release();
+    gpuProfiler.destroy();
+    vkDestroyQueryPool(device, statsQueryPool, nullptr);
 for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
     vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
     vkDestroyFence(device, inFlightFences[i], nullptr);
 }
     vkDestroyCommandPool(device, commandPool, nullptr);
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
+    for (VkCommandPool pool : recordCommandPools) {
+        vkDestroyCommandPool(device, pool, nullptr);
+    }
+    recordWorkers.reset();
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    savePipelineCache();
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
     vkDestroyRenderPass(device, renderPass, nullptr);
+    vkDestroyRenderPass(device, earlyRenderPass, nullptr);
+    vkDestroyRenderPass(device, lateRenderPass, nullptr);
+    stagingRing.destroy();
+    memoryAllocator.destroy();
     
     vkDestroyDevice(device, nullptr);
-    vkDestroySurfaceKHR(vkInstance, surface, nullptr);
+    if (surface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(vkInstance, surface, nullptr);
+    }
     vkDestroyInstance(vkInstance, nullptr);
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (window != nullptr) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
 }
\ No newline at end of file
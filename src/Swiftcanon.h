@@ -6,10 +6,27 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "MeshCache.h"
+#include "ObjLoader.h"
+#include "MemoryAllocator.h"
+#include "StagingRing.h"
+#include "Instances.h"
+#include "WorkerPool.h"
+#include "PipelineManager.h"
+#include "ShaderVariants.h"
+#include "Benchmark.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+
 #include <array>
+#include <chrono>
+#include <deque>
 #include <vector>
 #include <string>
+#include <memory>
 #include <optional>
+#include <functional>
+#include <unordered_map>
 
 struct UniformBufferObject {
     alignas(16) glm::mat4 model;
@@ -17,42 +34,152 @@ struct UniformBufferObject {
     alignas(16) glm::mat4 proj;
 };
 
-struct Vertex {
-    glm::vec3 pos;
-    glm::vec3 color;
-    
-    static VkVertexInputBindingDescription getBindingDescription() {
-        VkVertexInputBindingDescription bindingDescription{};
-        bindingDescription.binding      = 0;
-        bindingDescription.stride       = sizeof(Vertex);
-        bindingDescription.inputRate    = VK_VERTEX_INPUT_RATE_VERTEX;
-        return bindingDescription;
-    }
-    
-    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
-        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
-        attributeDescriptions[0].binding    = 0;
-        attributeDescriptions[0].location   = 0;
-        attributeDescriptions[0].format     = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[0].offset     = offsetof(Vertex, pos);
-        attributeDescriptions[1].binding    = 0;
-        attributeDescriptions[1].location   = 1;
-        attributeDescriptions[1].format     = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[1].offset     = offsetof(Vertex, color);
-        return attributeDescriptions;
-    }
+// Startup configuration, filled from the command line in main.cpp
+struct SwiftcanonOptions {
+    VertexFormat    vertexFormat     = VERTEX_FORMAT_FLOAT32;
+    bool            clusterCulling   = true;
+    float           lodErrorPixels   = 1.0f;     // Largest projected simplification error allowed on screen
+    int             forcedLod        = -1;       // Draw this LOD instead of selecting one, -1 selects automatically
+    uint32_t        instanceCount    = 1;        // Copies of the model laid out on a grid
+    bool            gpuCulling       = true;     // Frustum cull instances in a compute pass and draw them indirectly
+    bool            occlusionCulling = true;     // Two-pass Hi-Z occlusion culling on top of gpuCulling
+    bool            cacheCommands    = true;     // Reuse recorded command buffers while nothing they reference changes
+    uint32_t        recordThreads    = 1;        // Threads recording draws into secondary command buffers, 0 picks one per core
+    bool            pipelineCache    = true;     // Load compiled pipelines from PIPELINE_CACHE_PATH and save them on exit
+    bool            asyncPipelines   = true;     // Draw with fallbacks while pipelines compile instead of waiting for them in init
+    ShadingMode     shadingMode      = SHADING_MODE_TINT;
+    uint32_t        width            = 800;      // Initial window size, fixed render size when headless
+    uint32_t        height           = 600;
+    bool            headless         = false;    // Render into offscreen images without GLFW, a surface or a swapchain
+    uint64_t        frameCount       = 0;        // Frames to draw before exiting, 0 runs until the window closes
+    bool            benchmark        = false;    // Simulated time and a scripted camera, timings written to benchmarkOutput
+    uint64_t        warmupFrames     = 100;      // Benchmark frames drawn before measuring, on top of frameCount
+    std::string     benchmarkOutput  = "benchmark.json";
+    bool            gpuProfiler      = false;    // Time GPU passes with timestamp queries and log rolling averages, always on for benchmarks
+    std::string     cpuTrace;                    // Record CPU markers and write them here as a Chrome trace on exit, empty disables
+    bool            pipelineStats    = false;    // Count vertices, primitives and shader invocations of the render passes
+};
+
+// Simulated time per benchmark frame in seconds, animation doesn't depend on how fast frames are drawn
+const float BENCHMARK_TIME_STEP = 1.0f / 60.0f;
+
+// Camera data of both cull shaders. Written every frame into a uniform buffer rather than push constants,
+// so recorded command buffers stay valid while the camera moves.
+struct CullCamera {
+    glm::vec4   frustumPlanes[6];       // Mesh space, meshlet culling
+    glm::vec4   cameraPosition;         // Mesh space, meshlet culling
+    glm::mat4   viewProjection;         // Instance culling
+    glm::vec4   boundingSphere;         // Instance culling, mesh bounds before the instance transform
+};
+
+// Push constants of cull.comp
+struct CullPushConstants {
+    uint32_t    firstMeshlet;
+    uint32_t    meshletCount;
+    uint32_t    indexStride;
+};
+
+// Push constants of instance_cull.comp
+struct InstanceCullPushConstants {
+    uint32_t    firstSubMesh;
+    uint32_t    subMeshCount;
+    uint32_t    instanceCount;
+    uint32_t    compact;
+    uint32_t    pass;
+};
+
+// Dispatches of instance_cull.comp, the early and late pass bracket the Hi-Z pyramid build
+enum InstanceCullPass {
+    INSTANCE_CULL_SINGLE,       // Frustum culling only
+    INSTANCE_CULL_EARLY,        // Instances visible last frame
+    INSTANCE_CULL_LATE,         // Everything else, tested against the Hi-Z pyramid
+};
+
+// Push constants of hiz_build.comp
+struct HiZPushConstants {
+    uint32_t    sourceSize[2];
+    uint32_t    destinationSize[2];
 };
 
+// Instance counts of one frame drawn with GPU culling, written by instance_cull.comp
+struct CullStats {
+    uint32_t    frustumCulled;
+    uint32_t    occlusionCulled;
+    uint32_t    drawnEarly;         // Visible last frame, drawn before the Hi-Z pyramid is built
+    uint32_t    drawnLate;          // Newly visible, drawn after testing against the pyramid
+};
+
+// Counters of PIPELINE_STATISTICS_FLAGS, in the order of their bits, which is the order the query returns them
+struct PipelineStats {
+    uint64_t    inputVertices;
+    uint64_t    inputPrimitives;
+    uint64_t    vertexShaderInvocations;
+    uint64_t    clippingInvocations;    // Primitives that reached the clipper, after frustum and back-face culling
+    uint64_t    clippingPrimitives;     // Primitives left after clipping
+    uint64_t    fragmentShaderInvocations;
+};
+
+const VkQueryPipelineStatisticFlags PIPELINE_STATISTICS_FLAGS =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+// What a cached command buffer was recorded against, it is replayed as long as all of it still matches
+struct RecordedCommands {
+    bool        valid;
+    uint64_t    epoch;              // commandBufferEpoch at record time
+    uint32_t    lod;
+    uint32_t    instanceCount;
+    uint32_t    pipelinesReady;     // Pipelines still compiling were replaced by fallbacks
+};
+
+// Destruction of objects the GPU may still use, runs once every frame submitted before it was queued has finished
+struct DeferredDeletion {
+    uint64_t                frame;      // submittedFrames when queued
+    std::function<void()>   destroy;
+};
+
+// How culled instances reach the GPU, from best to worst supported
+enum IndirectDrawMode {
+    INDIRECT_DRAW_COUNT,        // vkCmdDrawIndexedIndirectCount over the compacted visible draws
+    INDIRECT_DRAW_MULTI,        // vkCmdDrawIndexedIndirect over every instance, culled ones have instanceCount 0
+    INDIRECT_DRAW_NONE,         // No GPU culling, one instanced vkCmdDrawIndexed per sub-mesh
+};
+
+// Instance draw buffers start with the draw count, commands follow at this offset
+const VkDeviceSize INSTANCE_DRAW_COMMANDS_OFFSET = 16;
+
+// Fewest CPU draws a recording thread gets, smaller lists record inline since executing secondaries costs more
+// than it saves
+const uint32_t RECORD_DRAWS_PER_THREAD = 2048;
+
+// Driver pipeline cache blob, relative to the working directory like the shaders and models
+const char* const PIPELINE_CACHE_PATH = "pipeline.cache";
+
 struct DeviceDetails {
     const char* name;
     int         deviceIndex;
     int         score;
     uint32_t    extensionCount;
+    bool        timelineSemaphores;
+    bool        drawIndirectCount;
+    bool        multiDrawIndirect;
+    bool        drawIndirectFirstInstance;
+    uint32_t    maxDrawIndirectCount;
+    float       timestampPeriod;        // Nanoseconds per timestamp tick
+    uint32_t    timestampValidBits;     // Of the graphics family, 0 without timestamp support
+    bool        pipelineStatisticsQuery;
+    bool        inheritedQueries;       // Secondary command buffers may run inside an active query
 };
 
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // Family without graphics for uploads, transfer-only (DMA) preferred over async compute
+    std::optional<uint32_t> transferFamily;
     bool isComplete() {
         return graphicsFamily.has_value() && presentFamily.has_value();
     }
@@ -61,9 +188,20 @@ struct QueueFamilyIndices {
 class Swiftcanon
 {
 public:
-    Swiftcanon();
+    Swiftcanon(const SwiftcanonOptions& options = {});
     void run();
     void init();
+    // Counts of the most recent frame the GPU has finished, zero without GPU culling
+    const CullStats& cullStats() const { return lastCullStats; }
+    // Switches to the next shading variant, drawn once its pipeline has compiled
+    void cycleShadingMode();
+    // GPU time per profiled pass, empty unless profiling or benchmarking on a device with timestamps
+    std::vector<GpuRegionStats> gpuStats() const { return gpuProfiler.stats(); }
+    // Counters of the most recent frame the GPU has finished, zero unless options.pipelineStats is set and the
+    // device has the pipelineStatisticsQuery feature
+    const PipelineStats& pipelineStats() const { return lastPipelineStats; }
+    // Writes the CPU markers recorded so far to options.cpuTrace, does nothing without it
+    void writeCpuTrace();
 
     // TODO: This doesn't seem like a good implementation
     bool framebufferResized = false;
@@ -74,6 +212,8 @@ private:
     void mainLoop();
     void cleanup();
 
+    SwiftcanonOptions               options;
+
     // Vulkan Compute Setup
     void addVulkanValidationLayers();
     void addVulkanInstanceExtensions();
@@ -86,6 +226,7 @@ private:
     std::vector<const char*> const  requiredValidationLayers;
     std::vector<const char*>        requiredVulkanExtensions;
     VkInstance                      vkInstance;
+    uint32_t                        instanceApiVersion = VK_API_VERSION_1_0;
     std::vector<DeviceDetails>      allDeviceDetails;
     std::vector<QueueFamilyIndices> allDeviceIndices;
     DeviceDetails                   physicalDeviceDetails;
@@ -94,69 +235,249 @@ private:
     std::vector<const char*>        requiredDeviceExtensions;
     VkDevice                        device;
     VkQueue                         graphicsQueue;
+    VkQueue                         transferQueue;
+    MemoryAllocator                 memoryAllocator;
+    StagingRing                     stagingRing;
 
     // Vulkan Presentation Setup
     void createSurface();
     void createSwapChain();
     void recreateSwapChain();
     void cleanupSwapChain();
+    void deferDeletion(std::function<void()> destroy);
+    void runDeferredDeletions(uint64_t completedFrames);
+    void createOffscreenTargets();
     void createImageViews();
     void createFramebuffers();
+    bool shouldClose();
+    double elapsedTime() const;
 
     // Vulkan Presentation Setup
-    GLFWwindow*                     window;
-    VkSurfaceKHR                    surface;
+    GLFWwindow*                     window                      = nullptr;
+    VkSurfaceKHR                    surface                     = VK_NULL_HANDLE;
     VkQueue                         presentQueue;
-    VkSwapchainKHR                  swapChain;
+    VkSwapchainKHR                  swapChain                   = VK_NULL_HANDLE;
     std::vector<VkImage>            swapChainImages;
     VkFormat                        swapChainImageFormat;
     VkExtent2D                      swapChainExtent;
     std::vector<VkImageView>        swapChainImageViews;
     std::vector<VkFramebuffer>      swapChainFramebuffers;
+    // Headless only, backing memory of the offscreen images standing in for swapChainImages
+    std::vector<MemoryAllocation>   offscreenImagesMemory;
+    std::deque<DeferredDeletion>    deletionQueue;
+    std::chrono::steady_clock::time_point startTime             = std::chrono::steady_clock::now();
 
     // Vulkan Pipeline Setup
+    void createPipelineCache();
+    void savePipelineCache();
     void createRenderPass();
     void createDescriptorSetLayout();
     void createGraphicsPipeline();
+    PipelineHandle graphicsPipelineVariant(ShaderFeatures features);
+    VkPipeline selectGraphicsPipeline();
+    VkPipeline buildGraphicsPipeline(ShaderFeatures features);
+    PipelineHandle compileComputePipeline(const std::string& name, const uint32_t* code, size_t size, VkPipelineLayout layout);
     void createCommandPool();
     void createDepthResources();
+    void createRenderPassVariant(VkAttachmentLoadOp loadOp, VkImageLayout colorInitialLayout, VkImageLayout colorFinalLayout,
+                                 VkAttachmentStoreOp depthStoreOp, VkRenderPass& pass);
     void createDescriptorPool();
     void createDescriptorSets();
     void createCommandBuffer();
     void createSyncObjects();
     void drawFrame();
+    void presentFrame(uint32_t imageIndex, VkSemaphore renderFinished);
     void updateUniformBuffer(uint32_t currentImage);
+    void updateCullCamera(uint32_t currentImage);
     void recordCommandBuffer(VkCommandBuffer command_buffer, uint32_t image_index);
-    VkShaderModule createShaderModule(const std::vector<char>& code);
+    // size in bytes
+    VkShaderModule createShaderModule(const uint32_t* code, size_t size);
 
     // Vulkan Pipeline Setup
+    VkPipelineCache                 pipelineCache               = VK_NULL_HANDLE;
+    PipelineManager                 pipelineManager;
+    bool                            pipelineCacheLoaded         = false;
+    bool                            firstFramePresented         = false;
     VkRenderPass                    renderPass;
     VkDescriptorSetLayout           descriptorSetLayout;
     VkPipelineLayout                pipelineLayout;
-    VkPipeline                      graphicsPipeline;
+    // Variants are compiled on first use and kept, at most one per combination of feature values
+    std::unordered_map<ShaderFeatures, PipelineHandle> graphicsVariants;
+    ShaderFeatures                  shaderFeatures              = 0;
+    ShaderFeatures                  drawnShaderFeatures         = 0;    // Newest variant that was ready, the fallback
+    VkPipeline                      boundGraphicsPipeline       = VK_NULL_HANDLE;   // Picked per recording, also used by the worker threads
+    VkFormat                        depthFormat;
     VkImage                         depthImage;
-    VkDeviceMemory                  depthImageMemory;
+    MemoryAllocation                depthImageMemory;
     VkImageView                     depthImageView;
     VkCommandPool                   commandPool;
     VkDescriptorPool                descriptorPool;
     std::vector<VkDescriptorSet>    descriptorSets;
+    // One per frame in flight and swapchain image, index currentFrame * swapChainImages.size() + imageIndex
     std::vector<VkCommandBuffer>    commandBuffers;
+    std::vector<RecordedCommands>   recordedCommands;
+    // Bumped whenever a buffer, image or descriptor set bound by the recorded commands is replaced
+    uint64_t                        commandBufferEpoch          = 0;
     std::vector<VkSemaphore>        imageAvailableSemaphores;
     std::vector<VkSemaphore>        renderFinishedSemaphores;
     std::vector<VkFence>            inFlightFences;
     const int                       MAX_FRAMES_IN_FLIGHT        = 2;
     uint32_t                        currentFrame                = 0;
+    uint64_t                        submittedFrames             = 0;
+
+    // Multithreaded Recording
+    void createRecordCommandPools();
+    void bindGraphicsState(VkCommandBuffer command_buffer);
+    void recordSceneDraws(VkCommandBuffer command_buffer, uint32_t firstInstance, uint32_t instanceCount);
+    void recordDrawRange(VkCommandBuffer command_buffer, uint32_t firstDraw, uint32_t endDraw);
+    void recordSecondaryDraws(VkCommandBuffer command_buffer, const VkRenderPassBeginInfo& renderPassInfo, uint32_t commandIndex, uint32_t threadCount);
+
+    // Multithreaded Recording
+    std::unique_ptr<WorkerPool>     recordWorkers;
+    // Every thread records from its own pool per frame in flight, index frame * recordWorkers->size() + thread
+    std::vector<VkCommandPool>      recordCommandPools;
+    // One per primary command buffer and thread, index commandIndex * recordWorkers->size() + thread
+    std::vector<VkCommandBuffer>    secondaryCommandBuffers;
 
     // Shaders Setup
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
+    MeshCache                       mesh;
+    VertexLayout                    vertexLayout;
+    // Maps packed [0, 1] positions back into mesh space, identity for VERTEX_FORMAT_FLOAT32
+    glm::mat4                       meshDequantize              = glm::mat4(1.0f);
+    // Camera state of the frame being recorded, model excludes meshDequantize
+    glm::mat4                       modelMatrix;
+    glm::mat4                       viewMatrix;
+    glm::mat4                       projMatrix;
+    glm::vec3                       cameraPosition;
     VkBuffer                        vertexBuffer;
-    VkDeviceMemory                  vertexBufferMemory;
+    MemoryAllocation                vertexBufferMemory;
     VkBuffer                        indexBuffer;
-    VkDeviceMemory                  indexBufferMemory;
+    MemoryAllocation                indexBufferMemory;
     std::vector<VkBuffer>           uniformBuffers;
-    std::vector<VkDeviceMemory>     uniformBuffersMemory;
+    std::vector<MemoryAllocation>   uniformBuffersMemory;
     std::vector<void*>              uniformBuffersMapped;
+    std::vector<VkBuffer>           cullCameraBuffers;
+    std::vector<MemoryAllocation>   cullCameraBuffersMemory;
+
+    // Cluster Culling
+    void createCullPipeline();
+    void createCullBuffers();
+    void recordCullPass(VkCommandBuffer command_buffer);
+
+    // Cluster Culling
+    VkDescriptorSetLayout           cullDescriptorSetLayout;
+    VkPipelineLayout                cullPipelineLayout;
+    PipelineHandle                  cullPipeline                = NO_PIPELINE;
+    VkBuffer                        meshletBuffer;
+    MemoryAllocation                meshletBufferMemory;
+    std::vector<VkBuffer>           culledIndexBuffers;
+    std::vector<MemoryAllocation>   culledIndexBuffersMemory;
+    std::vector<VkBuffer>           drawIndirectBuffers;
+    std::vector<MemoryAllocation>   drawIndirectBuffersMemory;
+    std::vector<VkDescriptorSet>    cullDescriptorSets;
+
+    // Instancing
+    void createInstances();
+    void updateInstanceBuffer(uint32_t currentImage);
+
+    // Instancing
+    InstanceSet                     instances;
+    // One host-written buffer per frame in flight, grown when the instance count passes its capacity
+    std::vector<VkBuffer>           instanceBuffers;
+    std::vector<MemoryAllocation>   instanceBuffersMemory;
+    std::vector<uint32_t>           instanceBufferCapacity;
+    // Camera distance and far plane multiplier so the whole instance grid is in view
+    float                           sceneScale                  = 1.0f;
+
+    // Instance Culling
+    void createInstanceCullPipeline();
+    void createInstanceCullBuffers();
+    void writeInstanceCullDescriptorSet(uint32_t frame);
+    void recordInstanceCullPass(VkCommandBuffer command_buffer, InstanceCullPass pass);
+    void recordInstanceDraws(VkCommandBuffer command_buffer, VkBuffer drawBuffer, uint32_t maxDrawCount);
+
+    // Instance Culling
+    IndirectDrawMode                indirectDrawMode            = INDIRECT_DRAW_NONE;
+    VkDescriptorSetLayout           instanceCullDescriptorSetLayout;
+    VkPipelineLayout                instanceCullPipelineLayout;
+    PipelineHandle                  instanceCullPipeline        = NO_PIPELINE;
+    VkBuffer                        subMeshBuffer;
+    MemoryAllocation                subMeshBufferMemory;
+    // Draw count and commands written by the cull pass, sized with the instance buffer of the same frame
+    std::vector<VkBuffer>           instanceDrawBuffers;
+    std::vector<MemoryAllocation>   instanceDrawBuffersMemory;
+    std::vector<VkBuffer>           instanceLateDrawBuffers;
+    std::vector<MemoryAllocation>   instanceLateDrawBuffersMemory;
+    // Two sets per frame, binding the early and the late draw buffer
+    std::vector<VkDescriptorSet>    instanceCullDescriptorSets;
+    // Set when the Hi-Z pyramid was recreated, each frame rewrites its own sets before recording
+    std::vector<bool>               instanceCullSetsStale;
+    uint32_t                        maxLodSubMeshes             = 0;
+
+    // Occlusion Culling
+    void createHiZPipeline();
+    void createHiZResources();
+    void cleanupHiZResources();
+    void recordHiZBuild(VkCommandBuffer command_buffer);
+    void collectCullStats(uint32_t frame);
+
+    // Occlusion Culling
+    VkRenderPass                    earlyRenderPass;
+    VkRenderPass                    lateRenderPass;
+    VkDescriptorSetLayout           hiZDescriptorSetLayout;
+    VkPipelineLayout                hiZPipelineLayout;
+    PipelineHandle                  hiZPipeline                 = NO_PIPELINE;
+    VkSampler                       hiZSampler;
+    // Pyramid sized to the depth buffer rounded down to powers of two, recreated with the swapchain
+    VkImage                         hiZImage                    = VK_NULL_HANDLE;
+    MemoryAllocation                hiZImageMemory;
+    VkImageView                     hiZImageView;
+    std::vector<VkImageView>        hiZMipViews;
+    VkDescriptorPool                hiZDescriptorPool;
+    std::vector<VkDescriptorSet>    hiZDescriptorSets;
+    VkExtent2D                      hiZExtent;
+    uint32_t                        hiZMipLevels                = 0;
+    // Last late pass result per instance, shared by all frames since frames run in order on the graphics queue
+    VkBuffer                        instanceVisibilityBuffer    = VK_NULL_HANDLE;
+    MemoryAllocation                instanceVisibilityBufferMemory;
+    uint32_t                        instanceVisibilityCapacity  = 0;
+    std::vector<VkBuffer>           cullStatsBuffers;
+    std::vector<MemoryAllocation>   cullStatsBuffersMemory;
+    CullStats                       lastCullStats{};
+    CullStats                       cullStatsTotal{};
+    uint32_t                        cullStatsFrames             = 0;
+    double                          cullStatsStartTime          = 0.0;
+
+    // Level of Detail
+    void selectLod();
+
+    // Profiling
+    void createGpuProfiler();
+    void beginGpuRegion(VkCommandBuffer command_buffer, const char* name);
+    void endGpuRegion(VkCommandBuffer command_buffer, const char* name);
+    void collectGpuTimings(uint32_t frame);
+    void createPipelineStatsQueries();
+    void collectPipelineStats(uint32_t frame);
+    void writeBenchmarkReport();
+
+    // Level of Detail
+    uint32_t                        currentLod                  = 0;
+    uint64_t                        lodTrianglesDrawn           = 0;
+    uint64_t                        lodTrianglesFull            = 0;
+    uint32_t                        lodStatsFrames              = 0;
+    double                          lodStatsStartTime           = 0.0;
+
+    // Profiling
+    Benchmark                       benchmark;
+    GpuProfiler                     gpuProfiler;
+    std::vector<uint64_t>           gpuTimingFrames;            // Frame whose timestamps a slot holds, UINT64_MAX once read
+    double                          gpuStatsStartTime           = 0.0;
+    VkQueryPool                     statsQueryPool              = VK_NULL_HANDLE;   // One pipeline statistics query per frame in flight
+    std::vector<uint64_t>           pipelineStatsFrames;        // Frame whose counters a query holds, UINT64_MAX once read
+    PipelineStats                   lastPipelineStats{};
+    PipelineStats                   pipelineStatsTotal{};
+    uint32_t                        pipelineStatsCount          = 0;
+    double                          pipelineStatsStartTime      = 0.0;
 
     // Shaders Setup
     void createVertexBuffer();
@@ -164,15 +485,14 @@ private:
     void createUniformBuffers();
 
     // Vulkan Helper Functions
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory,
+                      VkMemoryPropertyFlags preferredProperties = 0);
     VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
-    void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
-    VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+    void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageMemory,
+                     uint32_t mipLevels = 1);
+    VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t baseMipLevel = 0, uint32_t levelCount = 1);
 
     // UTIL
-    std::vector<char> readFile(const std::string& filename);
     void loadModel(const char* path);
 
     // TODO: not best way to to this, should have like a global debug setup
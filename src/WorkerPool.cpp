@@ -0,0 +1,63 @@
+#include "WorkerPool.h"
+#include "CpuProfiler.h"
+
+WorkerPool::WorkerPool(uint32_t threadCount)
+{
+    for (uint32_t i = 1; i < threadCount; i++) {
+        workers.emplace_back(&WorkerPool::workerLoop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::run(const std::function<void(uint32_t)>& function)
+{
+    if (!workers.empty()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &function;
+        pending = static_cast<uint32_t>(workers.size());
+        generation++;
+    }
+    wake.notify_all();
+
+    function(0);
+
+    if (!workers.empty()) {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+        task = nullptr;
+    }
+}
+
+void WorkerPool::workerLoop(uint32_t index)
+{
+    CpuProfiler::setThreadName("worker " + std::to_string(index));
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) {
+            return;
+        }
+        seen = generation;
+        const std::function<void(uint32_t)>* current = task;
+
+        lock.unlock();
+        (*current)(index);
+        lock.lock();
+
+        if (--pending == 0) {
+            done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+// Persistent threads for per-frame parallel work
+// run hands the same task to every thread with its index and returns once all of them have finished. The calling
+// thread takes index 0, so a pool of size 1 has no workers and runs the task inline.
+class WorkerPool
+{
+public:
+    explicit WorkerPool(uint32_t threadCount);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // The task must not throw, report failures through state it captures instead
+    void run(const std::function<void(uint32_t)>& task);
+
+    uint32_t size() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+private:
+    void workerLoop(uint32_t index);
+
+    std::vector<std::thread>                workers;
+    std::mutex                              mutex;
+    std::condition_variable                 wake;
+    std::condition_variable                 done;
+    const std::function<void(uint32_t)>*    task            = nullptr;
+    uint64_t                                generation      = 0;    // Bumped once per run, wakes every worker
+    uint32_t                                pending         = 0;    // Workers still busy with the current run
+    bool                                    stopping        = false;
+};
@@ -3,9 +3,149 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <algorithm>
 
-int main() {
-    Swiftcanon swiftcanon;
+static void printUsage(const char* program)
+{
+    std::cout << "Usage: " << program << " [options]" << std::endl;
+    std::cout << "  --vertex-format <float32|oct16|oct8>    GPU vertex layout (default float32)" << std::endl;
+    std::cout << "  --no-cluster-culling                    Draw every meshlet instead of culling them on the GPU" << std::endl;
+    std::cout << "  --lod-error <pixels>                    Largest projected LOD error on screen (default 1)" << std::endl;
+    std::cout << "  --lod <index>                           Always draw this LOD" << std::endl;
+    std::cout << "  --no-gpu-culling                        Draw every instance without the compute frustum culling pass" << std::endl;
+    std::cout << "  --no-occlusion-culling                  Skip the two-pass Hi-Z occlusion test of GPU culling" << std::endl;
+    std::cout << "  --no-command-cache                      Record the command buffer again every frame" << std::endl;
+    std::cout << "  --record-threads <count>                Threads recording large CPU draw lists, 0 for one per core (default 1)" << std::endl;
+    std::cout << "  --no-pipeline-cache                     Compile pipelines from scratch and don't save them" << std::endl;
+    std::cout << "  --sync-pipelines                        Wait for every pipeline during startup instead of compiling in the background" << std::endl;
+    std::cout << "  --shading <tint|faceted|normals|overdraw> Shading variant to start with, Tab cycles through them (default tint)" << std::endl;
+    std::cout << "  --instances <count>                     Draw this many copies of the model (default 1)" << std::endl;
+    std::cout << "  --resolution <width>x<height>           Window size, or render size when headless (default 800x600)" << std::endl;
+    std::cout << "  --headless                              Render offscreen without a window, stops after --frames (default 600)" << std::endl;
+    std::cout << "  --frames <count>                        Exit after drawing this many frames, measured frames with --benchmark" << std::endl;
+    std::cout << "  --benchmark                             Deterministic run with frame time percentiles, 1000 frames unless --frames is given" << std::endl;
+    std::cout << "  --warmup <count>                        Benchmark frames drawn before measuring (default 100)" << std::endl;
+    std::cout << "  --benchmark-output <path>               Where the benchmark JSON goes (default benchmark.json)" << std::endl;
+    std::cout << "  --gpu-profile                           Log the GPU time of every pass, averaged over the last 64 frames" << std::endl;
+    std::cout << "  --cpu-trace <path>                      Record CPU markers and write a Chrome trace on exit, P writes it at any time" << std::endl;
+    std::cout << "  --pipeline-stats                        Log vertices, primitives and shader invocations per frame from a pipeline statistics query" << std::endl;
+}
+
+enum ParseResult {
+    PARSE_OK,
+    PARSE_HELP,     // Usage was asked for, print it and exit successfully
+    PARSE_ERROR,
+};
+
+static ParseResult parseOptions(int argc, char** argv, SwiftcanonOptions& options)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--vertex-format" && i + 1 < argc) {
+            if (!parseVertexFormat(argv[++i], options.vertexFormat)) {
+                std::cerr << "Unknown vertex format: " << argv[i] << std::endl;
+                return PARSE_ERROR;
+            }
+        }
+        else if (arg == "--no-cluster-culling") {
+            options.clusterCulling = false;
+        }
+        else if (arg == "--lod-error" && i + 1 < argc) {
+            options.lodErrorPixels = std::strtof(argv[++i], nullptr);
+        }
+        else if (arg == "--lod" && i + 1 < argc) {
+            options.forcedLod = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (arg == "--no-gpu-culling") {
+            options.gpuCulling = false;
+        }
+        else if (arg == "--no-occlusion-culling") {
+            options.occlusionCulling = false;
+        }
+        else if (arg == "--no-command-cache") {
+            options.cacheCommands = false;
+        }
+        else if (arg == "--record-threads" && i + 1 < argc) {
+            options.recordThreads = static_cast<uint32_t>(std::max(0, std::atoi(argv[++i])));
+        }
+        else if (arg == "--no-pipeline-cache") {
+            options.pipelineCache = false;
+        }
+        else if (arg == "--sync-pipelines") {
+            options.asyncPipelines = false;
+        }
+        else if (arg == "--shading" && i + 1 < argc) {
+            if (!parseShadingMode(argv[++i], options.shadingMode)) {
+                std::cerr << "Unknown shading mode: " << argv[i] << std::endl;
+                return PARSE_ERROR;
+            }
+        }
+        else if (arg == "--instances" && i + 1 < argc) {
+            options.instanceCount = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if (arg == "--resolution" && i + 1 < argc) {
+            unsigned int width, height;
+            if (std::sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0) {
+                std::cerr << "Invalid resolution: " << argv[i] << std::endl;
+                return PARSE_ERROR;
+            }
+            options.width = width;
+            options.height = height;
+        }
+        else if (arg == "--headless") {
+            options.headless = true;
+        }
+        else if (arg == "--frames" && i + 1 < argc) {
+            options.frameCount = static_cast<uint64_t>(std::max(1ll, std::atoll(argv[++i])));
+        }
+        else if (arg == "--benchmark") {
+            options.benchmark = true;
+        }
+        else if (arg == "--warmup" && i + 1 < argc) {
+            options.warmupFrames = static_cast<uint64_t>(std::max(0ll, std::atoll(argv[++i])));
+        }
+        else if (arg == "--benchmark-output" && i + 1 < argc) {
+            options.benchmarkOutput = argv[++i];
+        }
+        else if (arg == "--gpu-profile") {
+            options.gpuProfiler = true;
+        }
+        else if (arg == "--pipeline-stats") {
+            options.pipelineStats = true;
+        }
+        else if (arg == "--cpu-trace" && i + 1 < argc) {
+            options.cpuTrace = argv[++i];
+        }
+        else if (arg == "--help" || arg == "-h") {
+            return PARSE_HELP;
+        }
+        else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return PARSE_ERROR;
+        }
+    }
+    // A benchmark measures a fixed number of frames so runs compare
+    if (options.benchmark && options.frameCount == 0) {
+        options.frameCount = 1000;
+    }
+    // Nothing else ends a headless run
+    if (options.headless && options.frameCount == 0) {
+        options.frameCount = 600;
+    }
+    return PARSE_OK;
+}
+
+int main(int argc, char** argv) {
+    SwiftcanonOptions options;
+    ParseResult parsed = parseOptions(argc, argv, options);
+    if (parsed != PARSE_OK) {
+        printUsage(argv[0]);
+        return parsed == PARSE_HELP ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    Swiftcanon swiftcanon(options);
     
     try{
         swiftcanon.init();
@@ -1,8 +1,35 @@
 #version 450
 
-layout(location = 0) in vec3 fragColor;
+// Must match ShadingMode in ShaderVariants.h
+layout(constant_id = 1) const uint SHADING_MODE = 0;
+const uint SHADING_MODE_TINT = 0;
+const uint SHADING_MODE_FACETED = 1;
+const uint SHADING_MODE_NORMALS = 2;
+const uint SHADING_MODE_OVERDRAW = 3;
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec3 fragColor;
+layout(location = 2) in vec3 fragViewPosition;
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec3 color;
+    if (SHADING_MODE == SHADING_MODE_FACETED) {
+        // View space face normal, its sign depends on the derivative orientation so the light is two-sided
+        vec3 faceNormal = normalize(cross(dFdx(fragViewPosition), dFdy(fragViewPosition)));
+        float diffuse = abs(dot(faceNormal, normalize(fragViewPosition)));
+        color = fragColor * (0.15 + 0.85 * diffuse);
+    }
+    else if (SHADING_MODE == SHADING_MODE_NORMALS) {
+        color = normalize(fragNormal) * 0.5 + 0.5;
+    }
+    else if (SHADING_MODE == SHADING_MODE_OVERDRAW) {
+        // Summed up by additive blending: red saturates after about 12 fragments, green after 33 and blue after 83,
+        // so the pixel goes from black through red and yellow to white
+        color = vec3(0.08, 0.03, 0.012);
+    }
+    else {
+        color = fragNormal * fragColor;
+    }
+    outColor = vec4(color, 1.0);
 }
\ No newline at end of file
@@ -1,17 +1,51 @@
 #version 450
 
+// Must match VertexFormat in Mesh.h
+layout(constant_id = 0) const uint VERTEX_FORMAT = 0;
+const uint VERTEX_FORMAT_FLOAT32 = 0;
+const uint VERTEX_FORMAT_OCT16 = 1;
+const uint VERTEX_FORMAT_OCT8 = 2;
+
 layout(binding = 0) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
 } ubo;
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
+// Packed formats store positions in [0, 1] over the mesh AABB, ubo.model scales them back
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inNormal;
+// Per-instance attributes, must match InstanceData in Instances.h
+layout(location = 2) in mat4 inInstanceModel;
+layout(location = 6) in vec4 inInstanceColor;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec3 fragColor;
+layout(location = 2) out vec3 fragViewPosition;
 
-layout(location = 0) out vec3 fragColor;
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
-    fragColor = inColor;
-}
\ No newline at end of file
+    vec3 normal;
+    if (VERTEX_FORMAT == VERTEX_FORMAT_OCT16) {
+        normal = octDecode(inNormal.xy);
+    }
+    else if (VERTEX_FORMAT == VERTEX_FORMAT_OCT8) {
+        // RGBA8 fetched at offset 4, the encoded normal is in the upper two bytes
+        normal = octDecode(inNormal.zw);
+    }
+    else {
+        normal = inNormal.xyz;
+    }
+
+    vec4 viewPosition = ubo.view * inInstanceModel * ubo.model * vec4(inPosition.xyz, 1.0);
+    gl_Position = ubo.proj * viewPosition;
+    fragNormal = normal;
+    fragColor = inInstanceColor.rgb;
+    fragViewPosition = viewPosition.xyz;
+}
@@ -0,0 +1,48 @@
+// swiftcanon-cook: converts OBJ models into the .smesh format loaded by Swiftcanon::loadModel
+//
+// Usage: swiftcanon-cook <input.obj> [output.smesh]
+// The output defaults to the input path with a .smesh extension, which is where loadModel looks for it.
+
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "ObjLoader.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <cstdlib>
+#include <chrono>
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.obj> [output.smesh]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string sourcePath = argv[1];
+    std::string cachePath = argc == 3 ? argv[2] : meshCachePath(sourcePath);
+
+    try{
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        MappedFile source;
+        if (!source.open(sourcePath)) {
+            throw std::runtime_error("[COOK] Failed to open " + sourcePath);
+        }
+        uint64_t sourceHash = hashBytes(source.data(), source.size());
+        source.close();
+
+        std::vector<char> image = cookMesh(sourcePath, sourceHash);
+        if (!writeMeshCache(cachePath, image)) {
+            throw std::runtime_error("[COOK] Failed to write " + cachePath);
+        }
+
+        float seconds = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+        std::cout << "[COOK] " << sourcePath << " -> " << cachePath << " (" << image.size() << " bytes, " << seconds << "s)" << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}